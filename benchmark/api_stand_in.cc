@@ -0,0 +1,256 @@
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QtLogging>
+#include <QDebug>
+
+#include <algorithm>
+
+#include "api_stand_in.hh"
+#include "../src/compress_helper.hh"
+
+using namespace Qt::Literals;
+
+namespace {
+
+QByteArray errorBody(int code, const char *message)
+{
+    return R"({"code":)" + QByteArray::number(code) + R"(,"message":")" + message
+            + R"(","ttl":1,"data":null})";
+}
+
+QByteArray reasonPhrase(int status)
+{
+    switch (status) {
+    case 200:
+        return "OK";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 412:
+        return "Precondition Failed";
+    default:
+        return "Internal Server Error";
+    }
+}
+
+} // namespace
+
+ApiStandIn::ApiStandIn(const Options &options, QObject *parent)
+    : QObject(parent),
+      options_(options),
+      store_(),
+      server_(new QTcpServer(this)),
+      rng_(options.seed),
+      window_begin_(0),
+      window_requests_(0),
+      request_count_(0)
+{
+    if (!options_.replay_dir.isEmpty()) {
+        // 只读取，不能删除录制或生成的响应
+        store_.setCapacity(0);
+        store_.setDirectory(options_.replay_dir);
+    }
+    clock_.start();
+    connect(server_, &QTcpServer::newConnection, this, &ApiStandIn::onNewConnection);
+}
+
+bool ApiStandIn::listen(const QHostAddress &address, quint16 port)
+{
+    if (!server_->listen(address, port)) {
+        qWarning() << "Unable to listen:" << server_->errorString();
+        return false;
+    }
+    return true;
+}
+
+quint16 ApiStandIn::port() const
+{
+    return server_->serverPort();
+}
+
+void ApiStandIn::onNewConnection()
+{
+    while (QTcpSocket *socket = server_->nextPendingConnection()) {
+        connections_.insert(socket, Connection());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            connections_.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void ApiStandIn::onReadyRead(QTcpSocket *socket)
+{
+    auto iter = connections_.find(socket);
+    if (iter == connections_.end()) {
+        return;
+    }
+    iter->buffer.append(socket->readAll());
+    // 只支持没有请求体的 GET
+    qsizetype end;
+    while ((end = iter->buffer.indexOf("\r\n\r\n")) >= 0) {
+        const QByteArray head = iter->buffer.first(end);
+        iter->buffer.remove(0, end + 4);
+        handleRequest(socket, head);
+        // handleRequest() 可能断开连接
+        iter = connections_.find(socket);
+        if (iter == connections_.end()) {
+            return;
+        }
+    }
+}
+
+void ApiStandIn::handleRequest(QTcpSocket *socket, const QByteArray &head)
+{
+    ++request_count_;
+    const QList<QByteArray> lines = head.split('\n');
+    const QList<QByteArray> request_line = lines.value(0).trimmed().split(' ');
+    QByteArray accept_encoding;
+    for (qsizetype i = 1; i < std::size(lines); ++i) {
+        const qsizetype colon = lines[i].indexOf(':');
+        if (colon > 0 && lines[i].first(colon).trimmed().toLower() == "accept-encoding") {
+            accept_encoding = lines[i].sliced(colon + 1).trimmed();
+        }
+    }
+
+    if (chance(options_.reset_rate)) {
+        socket->abort();
+        return;
+    }
+
+    Response response;
+    if (std::size(request_line) != 3 || request_line[0] != "GET") {
+        response = Response{ 405, errorBody(-405, "Method Not Allowed"), {} };
+    } else if (chance(options_.error_rate)) {
+        response = Response{ 500, errorBody(-500, "服务器错误"), {} };
+    } else if (rateLimited() || chance(options_.rate_limit_rate)) {
+        response = Response{ 412, errorBody(-412, "请求被拦截"), {} };
+    } else {
+        response = route(request_line[1], accept_encoding);
+    }
+
+    QByteArray out = "HTTP/1.1 " + QByteArray::number(response.status) + ' '
+            + reasonPhrase(response.status) + "\r\n"
+            + "Content-Type: application/json; charset=utf-8\r\n"
+            + "Content-Length: " + QByteArray::number(std::size(response.body)) + "\r\n";
+    if (!response.content_encoding.isEmpty()) {
+        out += "Content-Encoding: " + response.content_encoding + "\r\n";
+    }
+    out += "Connection: keep-alive\r\n\r\n" + response.body;
+
+    int delay = options_.latency_msec;
+    if (options_.jitter_msec > 0) {
+        delay += std::uniform_int_distribution<int>(-options_.jitter_msec,
+                                                    options_.jitter_msec)(rng_);
+    }
+    Connection &connection = connections_[socket];
+    const qint64 due = std::max(clock_.elapsed() + std::max(delay, 0), connection.last_due);
+    connection.last_due = due;
+    QTimer::singleShot(std::chrono::milliseconds(due - clock_.elapsed()), socket,
+                       [socket, out]() { socket->write(out); });
+}
+
+ApiStandIn::Response ApiStandIn::route(const QByteArray &target, const QByteArray &accept_encoding)
+{
+    const QUrl url(QString::fromLatin1(target));
+    const QUrlQuery query(url);
+    QString key;
+    if (url.path() == u"/x/vas/smelt/my_decompose/info"_s) {
+        key = OfflineStore::myDecomposeKey(query.queryItemValue(u"scene"_s).toInt());
+    } else if (url.path() == u"/x/vas/dlc_act/asset_bag"_s) {
+        key = OfflineStore::assetBagKey(query.queryItemValue(u"act_id"_s).toInt(),
+                                        query.queryItemValue(u"lottery_id"_s).toInt());
+    } else {
+        return Response{ 404, errorBody(-404, "啥都木有"), {} };
+    }
+
+    const QByteArray encoding = chooseEncoding(accept_encoding);
+    const QString cache_key = key % u'/' % QString::fromLatin1(encoding);
+    auto iter = encoded_.constFind(cache_key);
+    if (iter != encoded_.constEnd()) {
+        return Response{ 200, iter.value(), encoding };
+    }
+
+    QByteArray data;
+    QByteArray content_encoding;
+    if (!load(key, &data, &content_encoding)) {
+        return Response{ 200, errorBody(-404, "啥都木有"), {} };
+    }
+    if (content_encoding != encoding) {
+        bool ok = true;
+        if (!content_encoding.isEmpty()) {
+            data = uncompress(data, content_encoding, &ok);
+        }
+        if (ok && !encoding.isEmpty()) {
+            data = compress(data, encoding, &ok);
+        }
+        if (!ok) {
+            qWarning() << "Unable to re-encode" << key << "from" << content_encoding << "to"
+                       << encoding;
+            return Response{ 500, errorBody(-500, "服务器错误"), {} };
+        }
+    }
+    encoded_.insert(cache_key, data);
+    return Response{ 200, data, encoding };
+}
+
+bool ApiStandIn::load(const QString &key, QByteArray *data, QByteArray *content_encoding) const
+{
+    if (store_.isEnabled()) {
+        return store_.load(key, data, content_encoding);
+    }
+
+    const SyntheticAccount &account = options_.account;
+    content_encoding->clear();
+    if (key.startsWith(u"my_decompose_"_s)) {
+        *data = account.myDecompose(key.sliced(std::size(u"my_decompose_"_s)).toInt());
+        return true;
+    }
+    const QStringList parts = key.split(u'_');
+    // asset_bag_<act_id>_<lottery_id>
+    if (std::size(parts) != 4) {
+        return false;
+    }
+    *data = account.assetBag(parts[2].toInt(), parts[3].toInt());
+    return true;
+}
+
+QByteArray ApiStandIn::chooseEncoding(const QByteArray &accept_encoding) const
+{
+    if (options_.encoding == "identity") {
+        return {};
+    }
+    if (!options_.encoding.isEmpty()) {
+        return options_.encoding;
+    }
+    // 与服务器一致，优先使用 Brotli
+    for (const char *encoding : { "br", "gzip", "deflate" }) {
+        if (accept_encoding.contains(encoding)) {
+            return encoding;
+        }
+    }
+    return {};
+}
+
+bool ApiStandIn::rateLimited()
+{
+    if (options_.rate_limit_per_second <= 0) {
+        return false;
+    }
+    const qint64 now = clock_.elapsed();
+    if (now - window_begin_ >= 1000) {
+        window_begin_ = now;
+        window_requests_ = 0;
+    }
+    return ++window_requests_ > options_.rate_limit_per_second;
+}
+
+bool ApiStandIn::chance(double rate)
+{
+    return rate > 0 && std::uniform_real_distribution<double>(0, 1)(rng_) < rate;
+}
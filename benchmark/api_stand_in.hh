@@ -0,0 +1,89 @@
+#ifndef API_STAND_IN_HH
+#define API_STAND_IN_HH
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QHostAddress>
+
+#include <random>
+
+#include "synthetic_account.hh"
+#include "../src/offline_store.hh"
+
+QT_BEGIN_NAMESPACE
+class QTcpServer;
+class QTcpSocket;
+QT_END_NAMESPACE
+
+/// \brief 本地的 api.bilibili.com 替身，重放录制的或合成的 my_decompose 与 asset_bag 响应
+///
+/// 录制的响应即应用的离线缓存目录（OfflineStore 格式），其中没有的请求返回 code -404。
+/// 没有指定目录时由 SyntheticAccount 生成。只实现了应用用到的 HTTP/1.1 子集：GET 与 keep-alive。
+/// 应用通过环境变量 BILIBILICARDBROWSER_API_URL 指向这里。
+class ApiStandIn : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        QString replay_dir; ///< 为空时使用合成数据
+        SyntheticAccount account;
+        int latency_msec = 0;
+        int jitter_msec = 0; ///< 延迟在 latency ± jitter 之间均匀分布
+        QByteArray encoding; ///< 为空时按 Accept-Encoding 选择，"identity" 表示不压缩
+        double error_rate = 0; ///< 返回 HTTP 500 的比例
+        double reset_rate = 0; ///< 不响应而直接断开连接的比例
+        double rate_limit_rate = 0; ///< 返回 HTTP 412 与 code -412 的比例
+        int rate_limit_per_second = 0; ///< 每秒超过这么多请求后返回 -412，0 表示不限制
+        quint32 seed = 1;
+    };
+
+    explicit ApiStandIn(const Options &options, QObject *parent = nullptr);
+
+    bool listen(const QHostAddress &address, quint16 port);
+    [[nodiscard]] quint16 port() const;
+    [[nodiscard]] qint64 requestCount() const { return request_count_; }
+
+private:
+    struct Connection
+    {
+        QByteArray buffer;
+        qint64 last_due = 0; ///< 上一个响应的发送时间，保证同一连接上的响应按顺序发送
+    };
+
+    struct Response
+    {
+        int status;
+        QByteArray body;
+        QByteArray content_encoding;
+    };
+
+    void onNewConnection();
+    void onReadyRead(QTcpSocket *socket);
+    void handleRequest(QTcpSocket *socket, const QByteArray &head);
+    [[nodiscard]] Response route(const QByteArray &target, const QByteArray &accept_encoding);
+    /// 未压缩或压缩的原始响应，找不到时返回 false
+    bool load(const QString &key, QByteArray *data, QByteArray *content_encoding) const;
+    [[nodiscard]] QByteArray chooseEncoding(const QByteArray &accept_encoding) const;
+    /// 命中限流时返回 true
+    bool rateLimited();
+    [[nodiscard]] bool chance(double rate);
+
+    Options options_;
+    OfflineStore store_;
+    QTcpServer *server_;
+    QHash<QTcpSocket *, Connection> connections_;
+    /// {键 + 编码, 编码后的数据}，避免每次都重新压缩
+    QHash<QString, QByteArray> encoded_;
+    std::mt19937 rng_;
+    QElapsedTimer clock_;
+    qint64 window_begin_; ///< 限流窗口开始的毫秒数
+    int window_requests_;
+    qint64 request_count_;
+};
+
+#endif
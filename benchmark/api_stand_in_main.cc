@@ -0,0 +1,70 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QHostAddress>
+#include <QTextStream>
+
+#include "api_stand_in.hh"
+
+using namespace Qt::Literals;
+
+int main(int argc, char *argv[])
+{
+    // NOLINTBEGIN(readability-static-accessed-through-instance)
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+            u"本地的 api.bilibili.com 替身，用 BILIBILICARDBROWSER_API_URL=http://127.0.0.1:<port> "
+            "启动应用即可离线、可重复地测试导出与界面"_s);
+    parser.addHelpOption();
+    const QCommandLineOption port_option(u"port"_s, u"监听端口"_s, u"port"_s, u"8787"_s);
+    const QCommandLineOption replay_option(
+            u"replay"_s, u"重放 <dir> 中录制的响应（即应用的 cache 目录），否则使用合成数据"_s,
+            u"dir"_s);
+    const QCommandLineOption latency_option(u"latency"_s, u"每个响应的延迟"_s, u"ms"_s, u"0"_s);
+    const QCommandLineOption jitter_option(u"jitter"_s, u"延迟的随机波动"_s, u"ms"_s, u"0"_s);
+    const QCommandLineOption encoding_option(
+            u"encoding"_s, u"固定使用 gzip/br/deflate/identity，默认按 Accept-Encoding 选择"_s,
+            u"encoding"_s);
+    const QCommandLineOption error_rate_option(u"error-rate"_s, u"返回 HTTP 500 的比例"_s,
+                                               u"rate"_s, u"0"_s);
+    const QCommandLineOption reset_rate_option(u"reset-rate"_s, u"直接断开连接的比例"_s,
+                                               u"rate"_s, u"0"_s);
+    const QCommandLineOption rate_limit_rate_option(u"rate-limit-rate"_s,
+                                                    u"返回 code -412 的比例"_s, u"rate"_s, u"0"_s);
+    const QCommandLineOption rate_limit_option(u"rate-limit"_s,
+                                               u"每秒超过 <n> 个请求后返回 code -412"_s, u"n"_s,
+                                               u"0"_s);
+    parser.addOptions({ port_option, replay_option, latency_option, jitter_option,
+                        encoding_option, error_rate_option, reset_rate_option,
+                        rate_limit_rate_option, rate_limit_option });
+    // 合成数据的选项，--seed 同时用于注入错误
+    SyntheticAccount::addOptions(&parser, SyntheticAccount());
+    parser.process(app);
+
+    bool ok;
+    ApiStandIn::Options options;
+    options.account = SyntheticAccount::fromOptions(parser, &ok);
+    if (!ok) {
+        return 2;
+    }
+    options.replay_dir = parser.value(replay_option);
+    options.latency_msec = parser.value(latency_option).toInt();
+    options.jitter_msec = parser.value(jitter_option).toInt();
+    options.encoding = parser.value(encoding_option).toLatin1();
+    options.error_rate = parser.value(error_rate_option).toDouble();
+    options.reset_rate = parser.value(reset_rate_option).toDouble();
+    options.rate_limit_rate = parser.value(rate_limit_rate_option).toDouble();
+    options.rate_limit_per_second = parser.value(rate_limit_option).toInt();
+    options.seed = options.account.seed;
+
+    ApiStandIn stand_in(options);
+    if (!stand_in.listen(QHostAddress::LocalHost, parser.value(port_option).toUShort())) {
+        return 1;
+    }
+    QTextStream(stderr) << u"Listening on http://127.0.0.1:%1"_s.arg(stand_in.port()) << Qt::endl;
+
+    return app.exec();
+    // NOLINTEND(readability-static-accessed-through-instance)
+}
@@ -0,0 +1,424 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QRegularExpression>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QTextStream>
+#include <QList>
+#include <QtLogging>
+#include <QDebug>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "synthetic_account.hh"
+#include "../src/compress_helper.hh"
+#include "../src/asset_bag.hh"
+#include "../src/my_decompose.hh"
+#include "../src/card_store.hh"
+#include "../src/collection_export_worker.hh"
+#include "../src/allocation_accounting.hh"
+#include "../fuzz/fuzz_input.hh"
+
+using namespace Qt::Literals;
+
+namespace {
+
+const void *volatile sink = nullptr;
+
+/// 避免编译器优化掉没有使用的结果
+template <typename Tp>
+void doNotOptimize(const Tp &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    sink = &value;
+#endif
+}
+
+struct Result
+{
+    QString name;
+    nlohmann::json parameters;
+    qint64 bytes; ///< 每次处理的字节数，0 表示不计算吞吐量
+    std::vector<qint64> samples; ///< 每次的耗时，纳秒，已排序
+    quint64 allocations; ///< 每次的分配次数，只在 ENABLE_ALLOCATION_ACCOUNTING 时统计
+    quint64 allocated_bytes;
+
+    [[nodiscard]] qint64 percentile(double p) const
+    {
+        const double last = static_cast<double>(std::size(samples) - 1);
+        return samples[static_cast<std::size_t>(p * last)];
+    }
+};
+
+class Runner
+{
+public:
+    Runner(const QRegularExpression &filter, qint64 min_time_ns)
+        : filter_(filter), min_time_ns_(min_time_ns)
+    {
+    }
+
+    /// 之后的结果都附带这些参数，用于区分 --sweep 中的各个规模
+    void setParameters(const nlohmann::json &parameters) { parameters_ = parameters; }
+
+    /// 先运行一次预热，之后至少运行 min_time 与 5 次
+    void run(const QString &name, qint64 bytes, const std::function<void()> &fn)
+    {
+        if (!filter_.match(name).hasMatch()) {
+            return;
+        }
+        fn();
+
+        Result result{ name, parameters_, bytes, {}, 0, 0 };
+        if (Allocation::isEnabled()) {
+            const auto [allocations, allocated_bytes] = allocationTotals();
+            fn();
+            const auto [allocations_after, allocated_bytes_after] = allocationTotals();
+            result.allocations = allocations_after - allocations;
+            result.allocated_bytes = allocated_bytes_after - allocated_bytes;
+        }
+        QElapsedTimer total;
+        total.start();
+        while (total.nsecsElapsed() < min_time_ns_ || std::size(result.samples) < 5) {
+            QElapsedTimer timer;
+            timer.start();
+            fn();
+            result.samples.push_back(timer.nsecsElapsed());
+        }
+        std::sort(result.samples.begin(), result.samples.end());
+
+        QTextStream err(stderr);
+        err << qSetFieldWidth(40) << Qt::left << name << qSetFieldWidth(0)
+            << u"%1 次  中位数 %2 ms"_s.arg(static_cast<qsizetype>(std::size(result.samples)))
+                       .arg(static_cast<double>(result.percentile(0.5)) / 1e6, 0, 'f', 3);
+        if (bytes > 0) {
+            err << u"  %1 MiB/s"_s.arg(throughput(result), 0, 'f', 1);
+        }
+        if (Allocation::isEnabled()) {
+            err << u"  %1 次分配 %2 KiB"_s.arg(result.allocations)
+                            .arg(static_cast<double>(result.allocated_bytes) / 1024, 0, 'f', 1);
+        }
+        err << Qt::endl;
+        results_.push_back(std::move(result));
+    }
+
+    [[nodiscard]] nlohmann::json toJson() const
+    {
+        nlohmann::json j = nlohmann::json::array();
+        for (auto &&result : results_) {
+            nlohmann::json r = {
+                { "name", result.name.toStdString() },
+                { "parameters", result.parameters },
+                { "iterations", std::size(result.samples) },
+                { "min_ns", result.samples.front() },
+                { "median_ns", result.percentile(0.5) },
+                { "p90_ns", result.percentile(0.9) },
+                { "max_ns", result.samples.back() },
+            };
+            if (result.bytes > 0) {
+                r["bytes"] = result.bytes;
+                r["mib_per_second"] = throughput(result);
+            }
+            if (Allocation::isEnabled()) {
+                r["allocations"] = result.allocations;
+                r["allocated_bytes"] = result.allocated_bytes;
+            }
+            j.push_back(std::move(r));
+        }
+        return j;
+    }
+
+private:
+    /// 所有子系统累计的分配次数与字节数
+    [[nodiscard]] static std::pair<quint64, quint64> allocationTotals()
+    {
+        std::pair<quint64, quint64> totals{ 0, 0 };
+        for (int i = 0; i < Allocation::kSubsystemCount; ++i) {
+            const Allocation::Counters counters =
+                    Allocation::counters(static_cast<Allocation::Subsystem>(i));
+            totals.first += counters.allocations;
+            totals.second += counters.allocated_bytes;
+        }
+        return totals;
+    }
+
+    [[nodiscard]] static double throughput(const Result &result)
+    {
+        return static_cast<double>(result.bytes) / (1024.0 * 1024.0)
+                / (static_cast<double>(result.percentile(0.5)) / 1e9);
+    }
+
+    QRegularExpression filter_;
+    qint64 min_time_ns_;
+    nlohmann::json parameters_;
+    std::vector<Result> results_;
+};
+
+void runCases(Runner *runner, const SyntheticAccount &account)
+{
+    const QByteArray asset_bag_json = account.assetBag(SyntheticAccount::actId(0));
+    const QByteArray my_decompose_json = account.myDecompose(1);
+    const CardStore store = CardStore::fromJson(asset_bag_json);
+    runner->setParameters({
+            { "collections", account.collections },
+            { "card_types", account.card_types },
+            { "cards_per_type", account.cards_per_type },
+            { "owned_ratio", account.owned_ratio },
+            { "lottery_pools", account.lottery_pools },
+            { "collect_items", account.collect_items },
+            { "skewed", account.distribution == SyntheticAccount::Distribution::Skewed },
+            { "seed", account.seed },
+            { "asset_bag_bytes", std::size(asset_bag_json) },
+            { "asset_bag_cards", store.cardCount() },
+            { "my_decompose_bytes", std::size(my_decompose_json) },
+    });
+
+    for (const char *name : { "gzip", "br", "deflate" }) {
+        const QByteArray compressed = compress(asset_bag_json, name);
+        runner->run(u"uncompress/%1"_s.arg(QLatin1StringView(name)), std::size(asset_bag_json),
+                    [&compressed, name]() { doNotOptimize(uncompress(compressed, name)); });
+    }
+
+    runner->run(u"parse/AssetBagData::fromJson"_s, std::size(asset_bag_json),
+                [&asset_bag_json]() { doNotOptimize(AssetBagData::fromJson(asset_bag_json)); });
+    runner->run(u"parse/CardStore::fromJson"_s, std::size(asset_bag_json),
+                [&asset_bag_json]() { doNotOptimize(CardStore::fromJson(asset_bag_json)); });
+    runner->run(u"parse/MyDecomposeData::fromJson"_s, std::size(my_decompose_json),
+                [&my_decompose_json]() {
+                    doNotOptimize(MyDecomposeData::fromJson(my_decompose_json));
+                });
+
+    const QByteArray rows = CollectionExportWorker::formatCsvRows(u"合成收藏集"_s, store, {});
+    runner->run(u"export/formatCsvRows"_s, std::size(rows), [&store]() {
+        doNotOptimize(CollectionExportWorker::formatCsvRows(u"合成收藏集"_s, store, {}));
+    });
+
+    AssetBag asset_bag;
+    asset_bag.resize(800, 600);
+    runner->run(u"render/AssetBag::setCardStore"_s, 0, [&asset_bag, &store]() {
+        asset_bag.setCardStore(store);
+        // 后续分片由间隔为 0 的定时器驱动
+        while (asset_bag.isPopulating()) {
+            QCoreApplication::processEvents();
+        }
+    });
+}
+
+/// 目录中所有文件的内容，按文件名排序
+QList<QByteArray> readCorpus(const QString &dir)
+{
+    QList<QByteArray> inputs;
+    const QDir d(dir);
+    for (auto &&name : d.entryList(QDir::Files, QDir::Name)) {
+        QFile file(d.filePath(name));
+        if (file.open(QIODevice::ReadOnly)) {
+            inputs.append(file.readAll());
+        }
+    }
+    return inputs;
+}
+
+qint64 totalBytes(const QList<QByteArray> &inputs)
+{
+    qint64 bytes = 0;
+    for (auto &&input : inputs) {
+        bytes += std::size(input);
+    }
+    return bytes;
+}
+
+/// 与 fuzz/ 中的各个模糊测试处理同样的输入，每次处理子目录中的所有文件，吞吐量按语料的总字节数计算
+void runCorpus(Runner *runner, const QString &dir)
+{
+    runner->setParameters({ { "corpus", dir.toStdString() } });
+
+    const QList<QByteArray> compressed = readCorpus(dir % u"/uncompress"_s);
+    if (!compressed.isEmpty()) {
+        runner->run(u"corpus/uncompress"_s, totalBytes(compressed), [&compressed]() {
+            for (auto &&input : compressed) {
+                doNotOptimize(FuzzInput::uncompress(input, kMaxUncompressedSize, nullptr));
+            }
+        });
+    }
+
+    const QList<QByteArray> asset_bags = readCorpus(dir % u"/asset_bag"_s);
+    if (!asset_bags.isEmpty()) {
+        runner->run(u"corpus/AssetBagData::fromJson"_s, totalBytes(asset_bags), [&asset_bags]() {
+            for (auto &&json : asset_bags) {
+                doNotOptimize(AssetBagData::fromJson(json));
+            }
+        });
+        runner->run(u"corpus/CardStore::fromJson"_s, totalBytes(asset_bags), [&asset_bags]() {
+            for (auto &&json : asset_bags) {
+                doNotOptimize(CardStore::fromJson(json));
+            }
+        });
+    }
+
+    const QList<QByteArray> my_decomposes = readCorpus(dir % u"/my_decompose"_s);
+    if (!my_decomposes.isEmpty()) {
+        runner->run(u"corpus/MyDecomposeData::fromJson"_s, totalBytes(my_decomposes),
+                    [&my_decomposes]() {
+                        for (auto &&json : my_decomposes) {
+                            doNotOptimize(MyDecomposeData::fromJson(json));
+                        }
+                    });
+    }
+}
+
+/// 以合成账号生成各个模糊测试的初始语料，也是 --corpus 的输入
+bool writeCorpus(const QString &dir, const SyntheticAccount &account)
+{
+    const auto write = [&dir](const QString &name, const QByteArray &data) {
+        const QString file_name = dir % '/' % name;
+        if (!QDir().mkpath(QFileInfo(file_name).path())) {
+            return false;
+        }
+        QSaveFile file(file_name);
+        return file.open(QIODevice::WriteOnly) && file.write(data) == std::size(data)
+                && file.commit();
+    };
+
+    QList<QPair<QString, QByteArray>> samples; // {名称, JSON}
+    for (const int scene : { 1, 2 }) {
+        const QByteArray json = account.myDecompose(scene);
+        samples.append({ u"my_decompose-%1"_s.arg(scene), json });
+        if (!write(u"my_decompose/%1.json"_s.arg(scene), json)) {
+            return false;
+        }
+    }
+    // 每个收藏集的结构相同，取前几个即可
+    for (int i = 0; i < std::min(account.collections, 4); ++i) {
+        const int act_id = SyntheticAccount::actId(i);
+        const QByteArray json = account.assetBag(act_id);
+        samples.append({ u"asset_bag-%1"_s.arg(act_id), json });
+        if (!write(u"asset_bag/%1.json"_s.arg(act_id), json)) {
+            return false;
+        }
+    }
+
+    const std::pair<const char *, StreamCompressor::Encoding> encodings[] = {
+        { "gzip", StreamCompressor::Encoding::Gzip },
+        { "br", StreamCompressor::Encoding::Brotli },
+        { "deflate", StreamCompressor::Encoding::Deflate },
+        { "zlib", StreamCompressor::Encoding::Zlib },
+    };
+    for (auto &&[encoding_name, encoding] : encodings) {
+        for (auto &&[name, json] : std::as_const(samples)) {
+            StreamCompressor compressor(encoding);
+            QByteArray compressed = compressor.compress(json);
+            compressed += compressor.finish();
+            const QString file_name =
+                    u"uncompress/%1-%2"_s.arg(QLatin1StringView(encoding_name), name);
+            if (!write(file_name, FuzzInput::encode(encoding, compressed))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // 不需要显示窗口，没有指定平台时使用 offscreen
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    // NOLINTBEGIN(readability-static-accessed-through-instance)
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+            u"解压、解析、导出与填充的基准测试，结果以 JSON 格式写入标准输出或 --output"_s);
+    parser.addHelpOption();
+    const QCommandLineOption filter_option(u"filter"_s, u"只运行名称匹配 <regex> 的测试"_s,
+                                           u"regex"_s, u"."_s);
+    const QCommandLineOption min_time_option(u"min-time"_s, u"每项至少运行 <ms> 毫秒"_s, u"ms"_s,
+                                             u"1000"_s);
+    const QCommandLineOption sweep_option(
+            u"sweep"_s, u"依次以逗号分隔的每个值作为 --cards-per-type 运行，得到随规模变化的曲线"_s,
+            u"list"_s);
+    const QCommandLineOption output_option(u"output"_s, u"将结果写入 <file>"_s, u"file"_s);
+    const QCommandLineOption corpus_option(
+            u"corpus"_s, u"不使用合成账号，测量处理模糊测试语料目录 <dir> 的吞吐量"_s, u"dir"_s);
+    const QCommandLineOption write_corpus_option(
+            u"write-corpus"_s, u"将合成账号作为模糊测试的初始语料写入 <dir> 后退出"_s, u"dir"_s);
+    parser.addOptions({ filter_option, min_time_option, sweep_option, output_option, corpus_option,
+                        write_corpus_option });
+    SyntheticAccount defaults;
+    defaults.collections = 200;
+    defaults.card_types = 60;
+    defaults.cards_per_type = 20;
+    defaults.collect_items = 3;
+    SyntheticAccount::addOptions(&parser, defaults);
+    parser.process(app);
+
+    bool ok;
+    SyntheticAccount account = SyntheticAccount::fromOptions(parser, &ok);
+    if (!ok) {
+        return 2;
+    }
+    QList<int> sweep{ account.cards_per_type };
+    if (parser.isSet(sweep_option)) {
+        sweep.clear();
+        for (auto &&value : parser.value(sweep_option).split(u',')) {
+            sweep.append(value.toInt(&ok));
+            if (!ok || sweep.last() < 0) {
+                qWarning() << "Invalid --sweep" << parser.value(sweep_option);
+                return 2;
+            }
+        }
+    }
+
+    if (parser.isSet(write_corpus_option)) {
+        if (!writeCorpus(parser.value(write_corpus_option), account)) {
+            qWarning() << "Unable to write corpus:" << parser.value(write_corpus_option);
+            return 1;
+        }
+        return 0;
+    }
+
+    Runner runner(QRegularExpression(parser.value(filter_option)),
+                  parser.value(min_time_option).toLongLong() * 1000000);
+    if (parser.isSet(corpus_option)) {
+        runCorpus(&runner, parser.value(corpus_option));
+    } else {
+        for (const int cards_per_type : std::as_const(sweep)) {
+            account.cards_per_type = cards_per_type;
+            runCases(&runner, account);
+        }
+    }
+
+    const nlohmann::json j = {
+        { "commit", GIT_COMMIT_HASH },
+        { "qt_version", qVersion() },
+        { "results", runner.toJson() },
+    };
+    const QByteArray out = QByteArray::fromStdString(j.dump(2)) + '\n';
+
+    if (!parser.isSet(output_option)) {
+        QTextStream(stdout) << out;
+        return 0;
+    }
+    QSaveFile file(parser.value(output_option));
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != std::size(out) || !file.commit()) {
+        qWarning() << "Unable to write file:" << parser.value(output_option);
+        return 1;
+    }
+    return 0;
+    // NOLINTEND(readability-static-accessed-through-instance)
+}
@@ -0,0 +1,52 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QTextStream>
+
+#include "synthetic_account.hh"
+
+using namespace Qt::Literals;
+
+int main(int argc, char *argv[])
+{
+    // NOLINTBEGIN(readability-static-accessed-through-instance)
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+            u"生成合成账号的 my_decompose 与 asset_bag 响应，以离线缓存的格式写入 <dir>，"
+            "可以复制为应用的 cache 目录或用作替身的 --replay"_s);
+    parser.addHelpOption();
+    const QCommandLineOption encoding_option(u"encoding"_s, u"用 gzip/br/deflate 压缩，默认不压缩"_s,
+                                             u"encoding"_s);
+    parser.addOption(encoding_option);
+    parser.addPositionalArgument(u"dir"_s, u"输出目录，不存在时创建"_s);
+    SyntheticAccount::addOptions(&parser, SyntheticAccount());
+    parser.process(app);
+
+    QTextStream err(stderr);
+    if (std::size(parser.positionalArguments()) != 1) {
+        parser.showHelp(2);
+    }
+
+    bool ok;
+    const SyntheticAccount account = SyntheticAccount::fromOptions(parser, &ok);
+    if (!ok) {
+        return 2;
+    }
+    const QByteArray encoding = parser.value(encoding_option).toLatin1();
+    if (!encoding.isEmpty() && encoding != "gzip" && encoding != "br" && encoding != "deflate") {
+        err << "Invalid --encoding " << encoding << '\n';
+        return 2;
+    }
+
+    const QString dir = parser.positionalArguments().first();
+    if (!account.writeTo(dir, encoding)) {
+        err << "Unable to write " << dir << '\n';
+        return 1;
+    }
+    err << u"%1 个收藏集，共 %2 张卡片"_s.arg(account.collections).arg(account.totalCards())
+        << Qt::endl;
+    return 0;
+    // NOLINTEND(readability-static-accessed-through-instance)
+}
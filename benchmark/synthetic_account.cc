@@ -0,0 +1,314 @@
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QtLogging>
+#include <QDebug>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "synthetic_account.hh"
+#include "../src/offline_store.hh"
+#include "../src/compress_helper.hh"
+
+using namespace Qt::Literals;
+
+namespace {
+
+std::mt19937 makeRng(quint32 seed, int act_id, int index)
+{
+    std::seed_seq seq{ seed, static_cast<quint32>(act_id), static_cast<quint32>(index) };
+    return std::mt19937(seq);
+}
+
+std::string padded(unsigned value, std::size_t width)
+{
+    std::string s = std::to_string(value);
+    if (std::size(s) < width) {
+        s.insert(0, width - std::size(s), '0');
+    }
+    return s;
+}
+
+std::string imageUrl(std::mt19937 &rng)
+{
+    static constexpr char kHex[] = "0123456789abcdef";
+    std::string url = "https://i0.hdslb.com/bfs/garb/item/";
+    for (int i = 0; i < 40; ++i) {
+        url += kHex[rng() % 16];
+    }
+    return url + ".png";
+}
+
+QByteArray response(nlohmann::json data)
+{
+    const nlohmann::json j = {
+        { "code", 0 },
+        { "message", "0" },
+        { "ttl", 1 },
+        { "data", std::move(data) },
+    };
+    return QByteArray::fromStdString(j.dump());
+}
+
+} // namespace
+
+int SyntheticAccount::cardTypeCount(int act_id) const
+{
+    if (distribution == Distribution::Fixed) {
+        return card_types;
+    }
+    std::mt19937 rng = makeRng(seed, act_id, -1);
+    return std::uniform_int_distribution<int>(std::max(card_types / 2, 1),
+                                              std::max(card_types * 3 / 2, 1))(rng);
+}
+
+SyntheticAccount::CardType SyntheticAccount::cardType(int act_id, int index) const
+{
+    std::mt19937 rng = makeRng(seed, act_id, index);
+    CardType type{};
+    type.owned = std::uniform_real_distribution<double>(0, 1)(rng) < owned_ratio;
+    if (!type.owned) {
+        return type;
+    }
+    if (distribution == Distribution::Fixed || cards_per_type <= 1) {
+        type.count = cards_per_type;
+    } else {
+        // 1 + Geometric(p) 的期望为 1 / p
+        type.count = 1 + std::geometric_distribution<int>(1.0 / cards_per_type)(rng);
+    }
+    return type;
+}
+
+qint64 SyntheticAccount::totalCards() const
+{
+    qint64 total = 0;
+    for (int i = 0; i < collections; ++i) {
+        const int act_id = actId(i);
+        for (int k = 0, n = cardTypeCount(act_id); k < n; ++k) {
+            total += cardType(act_id, k).count;
+        }
+    }
+    return total;
+}
+
+QByteArray SyntheticAccount::myDecompose(int scene) const
+{
+    nlohmann::json list = nlohmann::json::array();
+    for (int i = 0; i < collections; ++i) {
+        const int act_id = actId(i);
+        // scene 1 为拥有的张数，scene 2 为重复的张数
+        int card_num = 0;
+        for (int k = 0, n = cardTypeCount(act_id); k < n; ++k) {
+            const CardType type = cardType(act_id, k);
+            card_num += scene == 1 ? type.count : std::max(type.count - 1, 0);
+        }
+        std::mt19937 rng = makeRng(seed, act_id, -2);
+        list.push_back({
+                { "act_id", act_id },
+                { "act_name", "合成收藏集 " + std::to_string(i) },
+                { "act_img", imageUrl(rng) },
+                { "card_num", card_num },
+        });
+    }
+    return response({ { "list", std::move(list) } });
+}
+
+QByteArray SyntheticAccount::assetBag(int act_id, int lottery_id) const
+{
+    const std::string act = std::to_string(act_id);
+    const int pools = std::max(lottery_pools, 1);
+
+    const auto card_item = [](std::mt19937 &rng, long long card_type_id, const std::string &name,
+                              int scarcity, int owned) {
+        nlohmann::json card_id_list = nlohmann::json::array();
+        for (int k = 0; k < owned; ++k) {
+            card_id_list.push_back({
+                    { "card_id", card_type_id * 10000 + k },
+                    { "card_no", padded(rng() % 1000000, 6) },
+                    { "status", rng() % 10 == 0 ? 2 : 1 },
+                    { "card_right", { { "is_transfer", rng() % 4 == 0 ? 1 : 0 } } },
+            });
+        }
+        return nlohmann::json{
+            { "card_type_id", card_type_id },
+            { "card_name", name },
+            { "card_img", imageUrl(rng) },
+            { "card_type", 1 },
+            { "card_id_list", owned == 0 ? nlohmann::json() : std::move(card_id_list) },
+            { "total_cnt", owned },
+            { "total_cnt_show", std::to_string(owned) },
+            { "holding_rate", static_cast<int>(rng() % 10001) },
+            { "card_scarcity", scarcity },
+            { "is_limited_card", scarcity >= 30 ? 1 : 0 },
+        };
+    };
+
+    nlohmann::json item_list = nlohmann::json::array();
+    int total_item_cnt = 0;
+    int owned_item_cnt = 0;
+    for (int i = 0, n = cardTypeCount(act_id); i < n; ++i) {
+        if (lottery_id != 0 && i % pools != lottery_id - 1) {
+            continue;
+        }
+        const CardType type = cardType(act_id, i);
+        // 前两个随机数已经用于 cardType()，这里从另一个序列开始
+        std::mt19937 rng = makeRng(seed ^ 0x9e3779b9U, act_id, i);
+        const int scarcity = static_cast<int>(rng() % 5) * 10;
+        item_list.push_back({
+                { "item_type", 1 },
+                { "item_scarcity", scarcity },
+                { "card_item",
+                  card_item(rng, static_cast<long long>(act_id) * 100000 + i,
+                            "合成卡片 " + act + "-" + std::to_string(i), scarcity, type.count) },
+        });
+        ++total_item_cnt;
+        owned_item_cnt += type.owned ? 1 : 0;
+    }
+
+    nlohmann::json collect_list = nlohmann::json::array();
+    for (int i = 0; lottery_id == 0 && i < collect_items; ++i) {
+        std::mt19937 rng = makeRng(seed, act_id, -3 - i);
+        const long long id = static_cast<long long>(act_id) * 100000 + 90000 + i;
+        const std::string name = "合成典藏卡 " + act + "-" + std::to_string(i);
+        const std::string image = imageUrl(rng);
+        const bool redeemed = owned_item_cnt == total_item_cnt;
+        collect_list.push_back({
+                { "collect_id", i + 1 },
+                { "start_time", 1700000000 },
+                { "end_time", 1800000000 },
+                { "redeem_text", "集齐全部卡片" },
+                { "redeem_item_type", 1 },
+                { "redeem_item_id", std::to_string(id) },
+                { "redeem_item_name", name },
+                { "redeem_item_image", image },
+                { "owned_item_amount", owned_item_cnt },
+                { "require_item_amount", total_item_cnt },
+                { "has_redeemed_cnt", redeemed ? 1 : 0 },
+                { "effective_forever", 1 },
+                { "card_item",
+                  {
+                          { "card_type_info",
+                            {
+                                    { "id", id },
+                                    { "name", name },
+                                    { "overview_image", image },
+                                    { "scarcity", 40 },
+                            } },
+                          { "card_asset_info",
+                            redeemed ? nlohmann::json{ { "item_type", 1 },
+                                                       { "item_scarcity", 40 },
+                                                       { "card_item",
+                                                         card_item(rng, id, name, 40, 1) } }
+                                     : nlohmann::json() },
+                  } },
+        });
+    }
+
+    nlohmann::json lottery_simple_list = nlohmann::json::array();
+    for (int i = 1; i <= pools; ++i) {
+        lottery_simple_list.push_back(
+                { { "lottery_id", i }, { "lottery_name", "第" + std::to_string(i) + "弹" } });
+    }
+
+    return response({
+            { "total_item_cnt", total_item_cnt },
+            { "owned_item_cnt", owned_item_cnt },
+            { "item_list", std::move(item_list) },
+            { "collect_list", std::move(collect_list) },
+            { "lottery_simple_list", std::move(lottery_simple_list) },
+    });
+}
+
+bool SyntheticAccount::writeTo(const QString &dir, const QByteArray &encoding) const
+{
+    OfflineStore store;
+    store.setCapacity(0);
+    store.setDirectory(dir);
+    if (!store.isEnabled()) {
+        return false;
+    }
+    const auto write = [&store, &encoding](const QString &key, const QByteArray &json) {
+        bool ok = true;
+        const QByteArray data = encoding.isEmpty() ? json : compress(json, encoding, &ok);
+        return ok && store.store(key, data, encoding);
+    };
+
+    for (const int scene : { 1, 2 }) {
+        if (!write(OfflineStore::myDecomposeKey(scene), myDecompose(scene))) {
+            return false;
+        }
+    }
+    for (int i = 0; i < collections; ++i) {
+        const int act_id = actId(i);
+        for (int lottery_id = 0; lottery_id <= std::max(lottery_pools, 1); ++lottery_id) {
+            const QString key = OfflineStore::assetBagKey(act_id, lottery_id);
+            if (!write(key, assetBag(act_id, lottery_id))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void SyntheticAccount::addOptions(QCommandLineParser *parser, const SyntheticAccount &defaults)
+{
+    parser->addOptions({
+            { u"collections"_s, u"收藏集数"_s, u"n"_s, QString::number(defaults.collections) },
+            { u"card-types"_s, u"每个收藏集的卡片种类数"_s, u"n"_s,
+              QString::number(defaults.card_types) },
+            { u"cards-per-type"_s, u"拥有的每种卡片的张数"_s, u"n"_s,
+              QString::number(defaults.cards_per_type) },
+            { u"owned-ratio"_s, u"拥有的卡片种类的比例"_s, u"ratio"_s,
+              QString::number(defaults.owned_ratio) },
+            { u"lottery-pools"_s, u"每个收藏集的奖池数"_s, u"n"_s,
+              QString::number(defaults.lottery_pools) },
+            { u"collect-items"_s, u"每个收藏集的典藏卡数"_s, u"n"_s,
+              QString::number(defaults.collect_items) },
+            { u"distribution"_s, u"fixed 或 skewed"_s, u"name"_s,
+              defaults.distribution == Distribution::Fixed ? u"fixed"_s : u"skewed"_s },
+            { u"seed"_s, u"随机数种子"_s, u"n"_s, QString::number(defaults.seed) },
+    });
+}
+
+SyntheticAccount SyntheticAccount::fromOptions(const QCommandLineParser &parser, bool *ok)
+{
+    SyntheticAccount account;
+    bool valid = true;
+    const auto integer = [&parser, &valid](const QString &name, int min) {
+        bool ok = false;
+        const int value = parser.value(name).toInt(&ok);
+        if (!ok || value < min) {
+            qWarning() << "Invalid option" << name << parser.value(name);
+            valid = false;
+        }
+        return value;
+    };
+
+    account.collections = integer(u"collections"_s, 0);
+    account.card_types = integer(u"card-types"_s, 0);
+    account.cards_per_type = integer(u"cards-per-type"_s, 0);
+    account.lottery_pools = integer(u"lottery-pools"_s, 1);
+    account.collect_items = integer(u"collect-items"_s, 0);
+    account.seed = static_cast<quint32>(integer(u"seed"_s, 0));
+    bool ratio_ok = false;
+    account.owned_ratio = parser.value(u"owned-ratio"_s).toDouble(&ratio_ok);
+    if (!ratio_ok || account.owned_ratio < 0 || account.owned_ratio > 1) {
+        qWarning() << "Invalid option owned-ratio" << parser.value(u"owned-ratio"_s);
+        valid = false;
+    }
+    const QString distribution = parser.value(u"distribution"_s);
+    if (distribution == u"skewed"_s) {
+        account.distribution = Distribution::Skewed;
+    } else if (distribution != u"fixed"_s) {
+        qWarning() << "Invalid --distribution" << distribution;
+        valid = false;
+    }
+
+    if (ok) {
+        *ok = valid;
+    }
+    return account;
+}
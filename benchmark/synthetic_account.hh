@@ -0,0 +1,60 @@
+#ifndef SYNTHETIC_ACCOUNT_HH
+#define SYNTHETIC_ACCOUNT_HH
+
+#include <QByteArray>
+#include <QString>
+#include <QtTypes>
+
+QT_BEGIN_NAMESPACE
+class QCommandLineParser;
+QT_END_NAMESPACE
+
+/// \brief 生成与真实接口结构相同的 my_decompose 与 asset_bag 响应
+///
+/// 同样的参数与种子总是生成同样的数据，可以在不同的构建之间比较。每种卡片的数据只由种子、
+/// act_id 与序号决定，因此全部奖池与单个奖池的响应、my_decompose 中的数量都是一致的。
+struct SyntheticAccount
+{
+    enum class Distribution {
+        Fixed, ///< 每个收藏集都有 card_types 种，拥有的每种都有 cards_per_type 张
+        Skewed, ///< 种类数在 [card_types / 2, card_types * 3 / 2] 之间，张数服从几何分布
+    };
+
+    int collections = 20; ///< my_decompose 中的收藏集数
+    int card_types = 30; ///< 每个收藏集所有奖池合计的卡片种类数
+    int cards_per_type = 4; ///< 拥有的每种卡片 card_id_list 的长度，Skewed 时为平均值
+    double owned_ratio = 1; ///< 拥有的卡片种类的比例，其余种类的 card_id_list 为 null
+    int lottery_pools = 1; ///< lottery_simple_list 的长度，种类依次分配到各个奖池
+    int collect_items = 2; ///< collect_list 的长度，只在全部奖池（lottery_id = 0）中出现
+    Distribution distribution = Distribution::Fixed;
+    quint32 seed = 1;
+
+    /// 第 index 个收藏集的 act_id
+    [[nodiscard]] static int actId(int index) { return 100 + index; }
+
+    [[nodiscard]] QByteArray myDecompose(int scene) const;
+    [[nodiscard]] QByteArray assetBag(int act_id, int lottery_id = 0) const;
+    /// 全部收藏集拥有的卡片总张数
+    [[nodiscard]] qint64 totalCards() const;
+
+    /// 以 OfflineStore 的格式写入，可以直接用于离线模式与 ApiStandIn 的 --replay；
+    /// encoding 为空时不压缩
+    bool writeTo(const QString &dir, const QByteArray &encoding) const;
+
+    /// 命令行选项的默认值取自 defaults
+    static void addOptions(QCommandLineParser *parser, const SyntheticAccount &defaults);
+    static SyntheticAccount fromOptions(const QCommandLineParser &parser, bool *ok = nullptr);
+
+private:
+    struct CardType
+    {
+        bool owned;
+        int count;
+    };
+
+    [[nodiscard]] int cardTypeCount(int act_id) const;
+    /// 只由种子、act_id 与序号决定
+    [[nodiscard]] CardType cardType(int act_id, int index) const;
+};
+
+#endif
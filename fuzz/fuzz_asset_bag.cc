@@ -0,0 +1,59 @@
+#include <QByteArray>
+#include <QLoggingCategory>
+#include <QtLogging>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../src/asset_bag.hh"
+#include "../src/card_store.hh"
+
+using namespace Qt::Literals;
+
+extern "C" int LLVMFuzzerInitialize(int * /*argc*/, char *** /*argv*/)
+{
+    // fromJson 对每个无效的输入都输出警告
+    QLoggingCategory::setFilterRules(u"default.warning=false"_s);
+    return 0;
+}
+
+/// 两个入口使用同一份 from_json，只是 json 的类型（ArenaJson 与 nlohmann::json）不同，
+/// 结果必须相同
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size)
+{
+    const QByteArray json = QByteArray::fromRawData(reinterpret_cast<const char *>(data),
+                                                    static_cast<qsizetype>(size));
+    bool store_ok;
+    const CardStore store = CardStore::fromJson(json, &store_ok);
+    if (!store_ok && store.typeCount() != 0) {
+        qFatal("Cards returned on failure");
+    }
+    // 访问每一列，越界由 AddressSanitizer 发现
+    for (qsizetype row = 0; row < store.typeCount(); ++row) {
+        static_cast<void>(store.scarcity(row));
+        for (qsizetype i = store.cardBegin(row); i < store.cardEnd(row); ++i) {
+            static_cast<void>(store.cardNo(i).toString());
+        }
+    }
+
+    bool data_ok;
+    const AssetBagData asset_bag_data = AssetBagData::fromJson(json, &data_ok);
+    if (store_ok != data_ok) {
+        qFatal("CardStore::fromJson and AssetBagData::fromJson disagree on validity");
+    }
+    if (!data_ok) {
+        return 0;
+    }
+    const CardStore expected = CardStore::fromAssetBagData(asset_bag_data);
+    if (store.typeCount() != expected.typeCount() || store.cardCount() != expected.cardCount()
+        || store.ownedItemCount() != expected.ownedItemCount()
+        || store.totalItemCount() != expected.totalItemCount()) {
+        qFatal("CardStore::fromJson and AssetBagData::fromJson disagree");
+    }
+    for (qsizetype i = 0; i < store.cardCount(); ++i) {
+        if (store.cardId(i) != expected.cardId(i) || store.cardNo(i) != expected.cardNo(i)) {
+            qFatal("Card %lld differs", static_cast<long long>(i));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef FUZZ_INPUT_HH
+#define FUZZ_INPUT_HH
+
+#include <QByteArray>
+
+#include "../src/compress_helper.hh"
+
+/// \brief 解压测试的输入格式：第一个字节除以 4 的余数为 StreamCompressor::Encoding，其余为压缩数据
+///
+/// 模糊测试与 benchmark 的 --corpus 共用，两边对同一份语料的解释相同。
+namespace FuzzInput {
+
+[[nodiscard]] inline QByteArray encode(StreamCompressor::Encoding encoding,
+                                      const QByteArray &compressed)
+{
+    return static_cast<char>(encoding) + compressed;
+}
+
+[[nodiscard]] inline StreamCompressor::Encoding encoding(const QByteArray &input)
+{
+    return static_cast<StreamCompressor::Encoding>(static_cast<unsigned char>(input.front()) % 4);
+}
+
+inline QByteArray uncompress(const QByteArray &input, qsizetype max_size, bool *ok)
+{
+    if (input.isEmpty()) {
+        if (ok) {
+            *ok = false;
+        }
+        return {};
+    }
+    const QByteArray src = input.sliced(1);
+    switch (encoding(input)) {
+    case StreamCompressor::Encoding::Gzip:
+        return uncompressGzip(src, ok, max_size);
+    case StreamCompressor::Encoding::Brotli:
+        return uncompressBrotli(src, ok, max_size);
+    case StreamCompressor::Encoding::Deflate:
+        return uncompressDeflate(src, ok, max_size);
+    case StreamCompressor::Encoding::Zlib:
+        return uncompressZlib(src, ok, max_size);
+    }
+    if (ok) {
+        *ok = false;
+    }
+    return {};
+}
+
+} // namespace FuzzInput
+
+#endif
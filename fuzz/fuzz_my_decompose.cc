@@ -0,0 +1,29 @@
+#include <QByteArray>
+#include <QLoggingCategory>
+#include <QtLogging>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../src/my_decompose.hh"
+
+using namespace Qt::Literals;
+
+extern "C" int LLVMFuzzerInitialize(int * /*argc*/, char *** /*argv*/)
+{
+    // fromJson 对每个无效的输入都输出警告
+    QLoggingCategory::setFilterRules(u"default.warning=false"_s);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size)
+{
+    const QByteArray json = QByteArray::fromRawData(reinterpret_cast<const char *>(data),
+                                                    static_cast<qsizetype>(size));
+    bool ok;
+    const MyDecomposeData d = MyDecomposeData::fromJson(json, &ok);
+    if (!ok && d.list.has_value()) {
+        qFatal("Data returned on failure");
+    }
+    return 0;
+}
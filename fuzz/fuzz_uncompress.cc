@@ -0,0 +1,51 @@
+#include <QByteArray>
+#include <QtLogging>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fuzz_input.hh"
+
+namespace {
+
+/// 比默认的 kMaxUncompressedSize 小得多，压缩比很高的输入也能很快结束
+constexpr qsizetype kMaxSize = qsizetype{ 1 } << 20;
+/// 只对不太大的输出做往返检查，保持每秒的执行次数
+constexpr qsizetype kMaxRoundTripSize = qsizetype{ 64 } << 10;
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size)
+{
+    const QByteArray input = QByteArray::fromRawData(reinterpret_cast<const char *>(data),
+                                                     static_cast<qsizetype>(size));
+    bool ok;
+    const QByteArray out = FuzzInput::uncompress(input, kMaxSize, &ok);
+    if (!ok) {
+        if (!out.isEmpty()) {
+            qFatal("Output returned on failure");
+        }
+        return 0;
+    }
+    if (std::size(out) > kMaxSize) {
+        qFatal("Output exceeds the size limit: %lld", static_cast<long long>(std::size(out)));
+    }
+    if (std::size(out) > kMaxRoundTripSize) {
+        return 0;
+    }
+
+    // 解压得到的数据重新压缩后必须能还原
+    StreamCompressor compressor(FuzzInput::encoding(input));
+    bool finish_ok;
+    QByteArray compressed = compressor.compress(out, &ok);
+    compressed += compressor.finish(&finish_ok);
+    if (!ok || !finish_ok) {
+        qFatal("Unable to compress");
+    }
+    const QByteArray round_trip = FuzzInput::uncompress(
+            FuzzInput::encode(compressor.encoding(), compressed), kMaxSize, &ok);
+    if (!ok || round_trip != out) {
+        qFatal("Round trip mismatch");
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <QRandomGenerator>
+
+#include <algorithm>
+
+#include "adaptive_poller.hh"
+
+using namespace std::chrono_literals;
+
+AdaptivePoller::AdaptivePoller(QObject *parent)
+    : QObject(parent), timer_(new QTimer(this)), min_(1min), max_(30min), interval_(min_)
+{
+    timer_->setSingleShot(true);
+    connect(timer_, &QTimer::timeout, this, [this]() {
+        // 先按没有变化计算下一次，结果到达后再由 reportResult() 修正
+        interval_ = std::min(interval_ * 2, max_);
+        schedule();
+        emit pollRequested();
+    });
+}
+
+void AdaptivePoller::setIntervalRange(std::chrono::milliseconds min, std::chrono::milliseconds max)
+{
+    min_ = min;
+    max_ = std::max(min, max);
+    interval_ = std::clamp(interval_, min_, max_);
+}
+
+void AdaptivePoller::start()
+{
+    interval_ = min_;
+    schedule();
+}
+
+void AdaptivePoller::stop()
+{
+    timer_->stop();
+}
+
+void AdaptivePoller::reportResult(bool changed)
+{
+    if (!changed || !isActive()) {
+        return;
+    }
+    interval_ = min_;
+    schedule();
+}
+
+void AdaptivePoller::schedule()
+{
+    const double jitter = 0.8 + 0.4 * QRandomGenerator::global()->generateDouble();
+    timer_->start(std::chrono::milliseconds(static_cast<qint64>(interval_.count() * jitter)));
+}
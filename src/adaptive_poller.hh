@@ -0,0 +1,45 @@
+#ifndef ADAPTIVE_POLLER_HH
+#define ADAPTIVE_POLLER_HH
+
+#include <QObject>
+#include <QTimer>
+
+#include <chrono>
+
+/// \brief 自适应间隔的轮询
+///
+/// 每次发出 pollRequested() 后间隔加倍，直到最长间隔；reportResult(true) 表示数据有变化，
+/// 间隔回到最短并从现在重新计时。每次的实际间隔有 ±20% 的随机抖动，避免多个实例同时请求。
+/// 请求失败时不需要报告，等同于没有变化。
+class AdaptivePoller : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AdaptivePoller(QObject *parent = nullptr);
+
+    void setIntervalRange(std::chrono::milliseconds min, std::chrono::milliseconds max);
+    [[nodiscard]] std::chrono::milliseconds minInterval() const { return min_; }
+    [[nodiscard]] std::chrono::milliseconds maxInterval() const { return max_; }
+    /// 下一次轮询之后使用的间隔（不含抖动）
+    [[nodiscard]] std::chrono::milliseconds interval() const { return interval_; }
+    [[nodiscard]] bool isActive() const { return timer_->isActive(); }
+
+public slots:
+    void start();
+    void stop();
+    void reportResult(bool changed);
+
+signals:
+    void pollRequested();
+
+private:
+    void schedule();
+
+    QTimer *timer_;
+    std::chrono::milliseconds min_;
+    std::chrono::milliseconds max_;
+    std::chrono::milliseconds interval_;
+};
+
+#endif
@@ -0,0 +1,302 @@
+#include <QtGlobal>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef ENABLE_ALLOCATION_ACCOUNTING
+#  if !defined(__GLIBC__)
+#    error "ENABLE_ALLOCATION_ACCOUNTING requires glibc"
+#  endif
+#  include <malloc.h>
+#  include <unistd.h>
+#endif
+
+#include "allocation_accounting.hh"
+
+namespace Allocation {
+
+static_assert(static_cast<int>(Subsystem::Export) + 1 == kSubsystemCount);
+
+namespace {
+
+struct alignas(64) Slot
+{
+    std::atomic<qint64> live_bytes{ 0 };
+    std::atomic<qint64> peak_bytes{ 0 };
+    std::atomic<quint64> allocations{ 0 };
+    std::atomic<quint64> allocated_bytes{ 0 };
+};
+
+// 第一次 malloc 可能早于任何静态对象的构造，这里只能是常量初始化
+Slot slot_table[kSubsystemCount];
+
+Slot &slotOf(Subsystem subsystem)
+{
+    return slot_table[static_cast<int>(subsystem)];
+}
+
+} // namespace
+
+const char *name(Subsystem subsystem)
+{
+    switch (subsystem) {
+    case Subsystem::Other:
+        return "其他";
+    case Subsystem::Network:
+        return "网络";
+    case Subsystem::Decompression:
+        return "解压";
+    case Subsystem::JsonParse:
+        return "JSON 解析";
+    case Subsystem::Widgets:
+        return "界面";
+    case Subsystem::Export:
+        return "导出";
+    }
+    return "未知";
+}
+
+Counters counters(Subsystem subsystem)
+{
+    const Slot &slot = slotOf(subsystem);
+    Counters c;
+    c.live_bytes = slot.live_bytes.load(std::memory_order_relaxed);
+    c.peak_bytes = slot.peak_bytes.load(std::memory_order_relaxed);
+    c.allocations = slot.allocations.load(std::memory_order_relaxed);
+    c.allocated_bytes = slot.allocated_bytes.load(std::memory_order_relaxed);
+    return c;
+}
+
+void resetPeaks()
+{
+    for (Slot &slot : slot_table) {
+        slot.peak_bytes.store(slot.live_bytes.load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+    }
+}
+
+} // namespace Allocation
+
+#ifdef ENABLE_ALLOCATION_ACCOUNTING
+
+// glibc 导出的原始实现，替换后的 malloc 一族都建立在它们之上
+extern "C" void *__libc_malloc(std::size_t size);
+extern "C" void *__libc_realloc(void *ptr, std::size_t size);
+extern "C" void __libc_free(void *ptr);
+
+namespace {
+
+using Allocation::Subsystem;
+
+constexpr quint32 kMagic = 0x6f6c6c61; // "allo"
+constexpr std::size_t kMaxAlignment = std::size_t{ 1 } << 23;
+
+/// 紧挨在返回的指针之前
+struct Header
+{
+    quint32 magic;
+    quint32 offset : 24; ///< 从 __libc_malloc 返回的地址到用户指针的距离
+    quint32 subsystem : 8;
+    quint64 size;
+};
+static_assert(sizeof(Header) == 16);
+constexpr std::size_t kHeaderSize = sizeof(Header);
+
+Header *headerOf(void *ptr)
+{
+    return static_cast<Header *>(ptr) - 1;
+}
+
+void account(Subsystem subsystem, qint64 delta)
+{
+    auto &slot = Allocation::slotOf(subsystem);
+    const qint64 live = slot.live_bytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+    if (delta <= 0) {
+        return;
+    }
+    slot.allocations.fetch_add(1, std::memory_order_relaxed);
+    slot.allocated_bytes.fetch_add(static_cast<quint64>(delta), std::memory_order_relaxed);
+    qint64 peak = slot.peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak
+           && !slot.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) { }
+}
+
+void *allocate(std::size_t size, std::size_t alignment = kHeaderSize)
+{
+    alignment = qMax(alignment, kHeaderSize);
+    if (alignment > kMaxAlignment || (alignment & (alignment - 1)) != 0) {
+        return nullptr;
+    }
+    // __libc_malloc 至少按 max_align_t 对齐，对齐要求更高时多分配一些再向上取整
+    const std::size_t padding =
+            kHeaderSize + alignment - qMin(alignment, alignof(std::max_align_t));
+    if (size > SIZE_MAX - padding) {
+        return nullptr;
+    }
+    char *raw = static_cast<char *>(__libc_malloc(size + padding));
+    if (raw == nullptr) {
+        return nullptr;
+    }
+    const auto address = reinterpret_cast<std::uintptr_t>(raw);
+    const std::uintptr_t aligned = (address + kHeaderSize + alignment - 1) & ~(alignment - 1);
+    char *ptr = raw + (aligned - address);
+
+    const Subsystem subsystem = Allocation::detail::current;
+    Header *header = headerOf(ptr);
+    header->magic = kMagic;
+    header->offset = static_cast<quint32>(aligned - address);
+    header->subsystem = static_cast<quint32>(subsystem);
+    header->size = size;
+    account(subsystem, static_cast<qint64>(size));
+    return ptr;
+}
+
+/// 不是由这里分配的指针（例如动态链接器在替换生效前分配的）原样交给 glibc
+void deallocate(void *ptr)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+    Header *header = headerOf(ptr);
+    if (header->magic != kMagic) {
+        __libc_free(ptr);
+        return;
+    }
+    account(static_cast<Subsystem>(header->subsystem), -static_cast<qint64>(header->size));
+    header->magic = 0;
+    __libc_free(static_cast<char *>(ptr) - header->offset);
+}
+
+/// 增长部分仍然记在最初分配的子系统上
+void *reallocate(void *ptr, std::size_t size)
+{
+    if (ptr == nullptr) {
+        return allocate(size);
+    }
+    Header *header = headerOf(ptr);
+    if (header->magic != kMagic) {
+        return __libc_realloc(ptr, size);
+    }
+    if (header->offset != kHeaderSize) {
+        void *new_ptr = allocate(size);
+        if (new_ptr != nullptr) {
+            std::memcpy(new_ptr, ptr, qMin<std::size_t>(size, header->size));
+            deallocate(ptr);
+        }
+        return new_ptr;
+    }
+    if (size > SIZE_MAX - kHeaderSize) {
+        return nullptr;
+    }
+    const auto subsystem = static_cast<Subsystem>(header->subsystem);
+    const auto old_size = static_cast<qint64>(header->size);
+    header = static_cast<Header *>(__libc_realloc(header, size + kHeaderSize));
+    if (header == nullptr) {
+        return nullptr;
+    }
+    header->size = size;
+    account(subsystem, static_cast<qint64>(size) - old_size);
+    return header + 1;
+}
+
+std::size_t pageSize()
+{
+    static const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+
+} // namespace
+
+// 按照 glibc 手册“Replacing malloc”一节的要求替换整个 malloc 一族，operator new 也经过这里
+extern "C" {
+
+void *malloc(std::size_t size) noexcept
+{
+    return allocate(size);
+}
+
+void free(void *ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void *calloc(std::size_t count, std::size_t size) noexcept
+{
+    if (size != 0 && count > SIZE_MAX / size) {
+        return nullptr;
+    }
+    void *ptr = allocate(count * size);
+    if (ptr != nullptr) {
+        std::memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *realloc(void *ptr, std::size_t size) noexcept
+{
+    if (ptr != nullptr && size == 0) {
+        deallocate(ptr);
+        return nullptr;
+    }
+    return reallocate(ptr, size);
+}
+
+void *reallocarray(void *ptr, std::size_t count, std::size_t size) noexcept
+{
+    if (size != 0 && count > SIZE_MAX / size) {
+        return nullptr;
+    }
+    return realloc(ptr, count * size);
+}
+
+void *memalign(std::size_t alignment, std::size_t size) noexcept
+{
+    return allocate(size, alignment);
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+    return allocate(size, alignment);
+}
+
+int posix_memalign(void **ptr, std::size_t alignment, std::size_t size) noexcept
+{
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *p = allocate(size, alignment);
+    if (p == nullptr) {
+        return ENOMEM;
+    }
+    *ptr = p;
+    return 0;
+}
+
+void *valloc(std::size_t size) noexcept
+{
+    return allocate(size, pageSize());
+}
+
+void *pvalloc(std::size_t size) noexcept
+{
+    const std::size_t page_size = pageSize();
+    if (size > SIZE_MAX - page_size) {
+        return nullptr;
+    }
+    return allocate((size + page_size - 1) & ~(page_size - 1), page_size);
+}
+
+std::size_t malloc_usable_size(void *ptr) noexcept
+{
+    if (ptr == nullptr || headerOf(ptr)->magic != kMagic) {
+        return 0;
+    }
+    return headerOf(ptr)->size;
+}
+
+} // extern "C"
+
+#endif
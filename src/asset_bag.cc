@@ -2,6 +2,9 @@
 #include <QTreeWidget>
 #include <QTreeWidgetItem>
 #include <QPushButton>
+#include <QProgressBar>
+#include <QTimer>
+#include <QElapsedTimer>
 #include <QResizeEvent>
 #include <QtLogging>
 #include <QDebug>
@@ -10,10 +13,14 @@
 
 #include "asset_bag.hh"
 #include "json_helper.hh"
+#include "json_arena.hh"
+#include "trace.hh"
+#include "allocation_accounting.hh"
 
 using namespace Qt::Literals;
 
-void from_json(const nlohmann::json &j, AssetBagData::CardIdListItem &item)
+template <typename BasicJsonType>
+void from_json(const BasicJsonType &j, AssetBagData::CardIdListItem &item)
 {
     j.at("card_id").get_to(item.card_id);
     j.at("card_no").get_to(item.card_no);
@@ -21,7 +28,8 @@ void from_json(const nlohmann::json &j, AssetBagData::CardIdListItem &item)
     j.at("card_right").at("is_transfer").get_to(item.card_right.is_transfer);
 }
 
-void from_json(const nlohmann::json &j, AssetBagData::ListItem::CardItem &item)
+template <typename BasicJsonType>
+void from_json(const BasicJsonType &j, AssetBagData::ListItem::CardItem &item)
 {
     j.at("card_type_id").get_to(item.card_type_id);
     j.at("card_name").get_to(item.card_name);
@@ -39,7 +47,8 @@ void from_json(const nlohmann::json &j, AssetBagData::ListItem::CardItem &item)
     j.at("is_limited_card").get_to(item.is_limited_card);
 }
 
-void from_json(const nlohmann::json &j, AssetBagData::ListItem &item)
+template <typename BasicJsonType>
+void from_json(const BasicJsonType &j, AssetBagData::ListItem &item)
 {
     j.at("item_type").get_to(item.item_type);
     j.at("item_scarcity").get_to(item.item_scarcity);
@@ -50,7 +59,8 @@ void from_json(const nlohmann::json &j, AssetBagData::ListItem &item)
     }
 }
 
-void from_json(const nlohmann::json &j, AssetBagData::CollectListItem::CardItem::CardTypeInfo &info)
+template <typename BasicJsonType>
+void from_json(const BasicJsonType &j, AssetBagData::CollectListItem::CardItem::CardTypeInfo &info)
 {
     j.at("id").get_to(info.id);
     j.at("name").get_to(info.name);
@@ -58,7 +68,8 @@ void from_json(const nlohmann::json &j, AssetBagData::CollectListItem::CardItem:
     j.at("scarcity").get_to(info.scarcity);
 }
 
-void from_json(const nlohmann::json &j, AssetBagData::CollectListItem::CardItem &item)
+template <typename BasicJsonType>
+void from_json(const BasicJsonType &j, AssetBagData::CollectListItem::CardItem &item)
 {
     auto &&card_type_info = j.at("card_type_info");
     if (!card_type_info.is_null()) {
@@ -70,7 +81,8 @@ void from_json(const nlohmann::json &j, AssetBagData::CollectListItem::CardItem
     }
 }
 
-void from_json(const nlohmann::json &j, AssetBagData::CollectListItem &item)
+template <typename BasicJsonType>
+void from_json(const BasicJsonType &j, AssetBagData::CollectListItem &item)
 {
     j.at("collect_id").get_to(item.collect_id);
     j.at("start_time").get_to(item.start_time);
@@ -91,13 +103,15 @@ void from_json(const nlohmann::json &j, AssetBagData::CollectListItem &item)
     }
 }
 
-void from_json(const nlohmann::json &j, AssetBagData::LotterySimpleListItem &item)
+template <typename BasicJsonType>
+void from_json(const BasicJsonType &j, AssetBagData::LotterySimpleListItem &item)
 {
     j.at("lottery_id").get_to(item.lottery_id);
     j.at("lottery_name").get_to(item.lottery_name);
 }
 
-void from_json(const nlohmann::json &j, AssetBagData &data)
+template <typename BasicJsonType>
+void from_json(const BasicJsonType &j, AssetBagData &data)
 {
     j.at("total_item_cnt").get_to(data.total_item_cnt);
     j.at("owned_item_cnt").get_to(data.owned_item_cnt);
@@ -118,37 +132,56 @@ void from_json(const nlohmann::json &j, AssetBagData &data)
     }
 }
 
+template <typename BasicJsonType>
+AssetBagData AssetBagData::fromJsonData(const BasicJsonType &data)
+{
+    AssetBagData d;
+    data.get_to(d);
+    return d;
+}
+
+template AssetBagData AssetBagData::fromJsonData(const nlohmann::json &data);
+template AssetBagData AssetBagData::fromJsonData(const ArenaJson &data);
+
 AssetBagData AssetBagData::fromJson(const QByteArray &json, bool *ok)
 {
+    TRACE_SCOPE("parse", "AssetBagData::fromJson");
+    ALLOCATION_SCOPE(JsonParse);
     if (ok) {
         *ok = false;
     }
 
     AssetBagData d;
 
-    do {
-        const nlohmann::json j = nlohmann::json::parse(json.toStdString(), nullptr, false);
-        if (j.is_discarded()) {
-            break;
-        }
+    try {
+        do {
+            const nlohmann::json j = nlohmann::json::parse(json.toStdString(), nullptr, false);
+            if (j.is_discarded()) {
+                break;
+            }
 
-        const int code = j.at("code").get<int>();
-        const std::string message = j.at("message").get<std::string>();
-        if (code != 0) {
-            qWarning() << "code:" << code << "message:" << message;
-            break;
-        }
+            const int code = j.at("code").get<int>();
+            const std::string message = j.at("message").get<std::string>();
+            if (code != 0) {
+                qWarning() << "code:" << code << "message:" << message;
+                break;
+            }
 
-        auto &&data = j.at("data");
-        if (!data.is_object()) {
-            break;
-        }
-        data.get_to(d);
+            auto &&data = j.at("data");
+            if (!data.is_object()) {
+                break;
+            }
+            d = fromJsonData(data);
 
-        if (ok) {
-            *ok = true;
-        }
-    } while (false);
+            if (ok) {
+                *ok = true;
+            }
+        } while (false);
+    } catch (const nlohmann::json::exception &e) {
+        // 缺少字段或类型不符时 at() 与 get() 仍然会抛出异常，与解析失败同样处理
+        qWarning() << "Invalid response:" << e.what();
+        d = AssetBagData();
+    }
 
     return d;
 }
@@ -162,7 +195,15 @@ AssetBag::AssetBag(QWidget *parent, Qt::WindowFlags f)
       tree_widget_(new QTreeWidget(this)),
       refresh_button_(new QPushButton(u"刷新"_s, this)),
       expand_all_button_(new QPushButton(u"展开全部"_s, this)),
-      collapse_all_button_(new QPushButton(u"折叠全部"_s, this))
+      collapse_all_button_(new QPushButton(u"折叠全部"_s, this)),
+      progress_bar_(new QProgressBar(this)),
+      populate_timer_(new QTimer(this)),
+      store_(),
+      loaded_(),
+      pending_index_(),
+      pending_card_index_(),
+      pending_top_item_(),
+      populated_rows_()
 {
     link_label_->adjustSize();
     item_cnt_label_->adjustSize();
@@ -173,6 +214,12 @@ AssetBag::AssetBag(QWidget *parent, Qt::WindowFlags f)
     link_label_->setTextInteractionFlags(Qt::TextBrowserInteraction);
     link_label_->setOpenExternalLinks(true);
     tree_widget_->move(link_label_->geometry().bottomLeft() + QPoint(0, 1));
+    progress_bar_->setTextVisible(true);
+    progress_bar_->setFormat(u"加载中... %v/%m"_s);
+    progress_bar_->hide();
+    // 间隔为 0 的定时器在每次事件循环处理完输入和重绘后触发
+    populate_timer_->setInterval(0);
+    connect(populate_timer_, &QTimer::timeout, this, &AssetBag::populateSlice);
 
     connect(refresh_button_, &QPushButton::clicked, this, [this]() {
         if (act_id_ == 0) {
@@ -215,85 +262,169 @@ void AssetBag::setInfo(int act_id, int lottery_id, const QString &act_name,
 
 void AssetBag::clearAssetBagData()
 {
+    populate_timer_->stop();
+    progress_bar_->hide();
+    store_ = CardStore();
+    loaded_ = false;
+    pending_index_ = 0;
+    pending_card_index_ = 0;
+    pending_top_item_ = nullptr;
+    populated_rows_ = 0;
     tree_widget_->clear();
 }
 
-void AssetBag::setAssetBagData(const AssetBagData &data)
+void AssetBag::setCardStore(const CardStore &store)
 {
     item_cnt_label_->setText(
-            u"拥有/总计: %1/%2"_s.arg(data.owned_item_cnt).arg(data.total_item_cnt));
+            u"拥有/总计: %1/%2"_s.arg(store.ownedItemCount()).arg(store.totalItemCount()));
     item_cnt_label_->adjustSize();
 
-    // 可以抽到的卡片
-    if (data.item_list.has_value()) {
-        for (auto &&item : data.item_list.value()) {
-            if (!item.card_item.has_value()) {
-                continue;
-            }
-            QTreeWidgetItem *top_item = new QTreeWidgetItem;
-            tree_widget_->addTopLevelItem(top_item);
-            tree_widget_->setItemWidget(top_item, 0, new QLabel(item.scarcity()));
-            tree_widget_->setItemWidget(top_item, 1, new QLabel(item.card_item->card_name));
-            tree_widget_->setItemWidget(top_item, 2,
-                                        new QLabel(QString::number(item.card_item->total_cnt)));
-            tree_widget_->setItemWidget(
-                    top_item, 3,
-                    new QLabel(QString::number(item.card_item->holding_rate / 100.0, 'g', 2)
-                               % '%'));
-            tree_widget_->setItemWidget(
-                    top_item, 4,
-                    new QLabel(item.card_item->is_limited_card != 0 ? u"限量"_s : u""_s));
-
-            if (item.card_item->card_id_list.has_value()) {
-                for (auto &&card : item.card_item->card_id_list.value()) {
-                    QTreeWidgetItem *sub_item = new QTreeWidgetItem(top_item);
-                    tree_widget_->setItemWidget(sub_item, 1, new QLabel(item.card_item->card_name));
-                    tree_widget_->setItemWidget(sub_item, 2, new QLabel(card.card_no));
-                    tree_widget_->setItemWidget(
-                            sub_item, 5,
-                            new QLabel(card.card_right.is_transfer != 0 ? u"转赠中"_s : u""_s));
-                }
-                top_item->setExpanded(true);
-            }
+    // 各列是隐式共享的，这里的复制很便宜
+    store_ = store;
+    loaded_ = true;
+    populate();
+}
+
+void AssetBag::unload()
+{
+    if (!loaded_) {
+        return;
+    }
+    populate_timer_->stop();
+    progress_bar_->hide();
+    pending_index_ = 0;
+    pending_card_index_ = 0;
+    pending_top_item_ = nullptr;
+    populated_rows_ = 0;
+    tree_widget_->clear();
+    loaded_ = false;
+}
+
+void AssetBag::reload()
+{
+    if (loaded_) {
+        return;
+    }
+    loaded_ = true;
+    populate();
+}
+
+void AssetBag::releaseCardStore()
+{
+    Q_ASSERT(!loaded_);
+    store_ = CardStore();
+}
+
+bool AssetBag::isPopulating() const
+{
+    return populate_timer_->isActive();
+}
+
+qsizetype AssetBag::memoryUsage() const
+{
+    return store_.memoryUsage() + populated_rows_ * kItemBytes;
+}
+
+void AssetBag::populate()
+{
+    TRACE_SCOPE("gui", "AssetBag::populate");
+    populate_timer_->stop();
+    tree_widget_->clear();
+    pending_index_ = 0;
+    pending_card_index_ = 0;
+    pending_top_item_ = nullptr;
+    populated_rows_ = 0;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-narrowing-conversions)
+    progress_bar_->setRange(0, store_.typeCount() + store_.cardCount());
+    progress_bar_->setValue(0);
+
+    // 第一片同步完成，保证第一屏立即可见
+    populateSlice();
+}
+
+void AssetBag::populateSlice()
+{
+    TRACE_SCOPE("gui", "AssetBag::populateSlice");
+    ALLOCATION_SCOPE(Widgets);
+    QElapsedTimer timer;
+    timer.start();
+
+    bool has_more = true;
+    while (timer.elapsed() < kSliceBudget) {
+        has_more = populateNext();
+        if (!has_more) {
+            break;
         }
     }
 
-    // 典藏卡
-    if (data.collect_list.has_value()) {
-        for (auto &&collect : data.collect_list.value()) {
-            if (!collect.card_item.has_value() || !collect.card_item->card_type_info.has_value()) {
-                continue;
-            }
+    if (has_more) {
+        progress_bar_->setValue(populated_rows_);
+        progress_bar_->show();
+        if (!populate_timer_->isActive()) {
+            populate_timer_->start();
+        }
+        return;
+    }
+
+    populate_timer_->stop();
+    progress_bar_->hide();
+    {
+        // 需要测量所有行，行数多时很慢
+        TRACE_SCOPE("gui", "AssetBag::resizeColumnToContents");
+        tree_widget_->resizeColumnToContents(1);
+        tree_widget_->resizeColumnToContents(2);
+    }
+}
+
+bool AssetBag::populateNext()
+{
+    const CardStore &store = store_;
+
+    while (pending_index_ < store.typeCount()) {
+        const qsizetype row = pending_index_;
+        // 同名的卡与所有子项共享全局表中的同一个字符串
+        const QString &card_name = store.cardName(row).toString();
+
+        if (pending_top_item_ == nullptr) {
             QTreeWidgetItem *top_item = new QTreeWidgetItem;
+            top_item->setText(0, store.scarcity(row).toString());
+            top_item->setText(1, card_name);
+            top_item->setText(2, QString::number(store.totalCount(row)));
+            if (store.isCollect(row)) {
+                // 典藏卡
+                top_item->setText(3, u"/"_s);
+                top_item->setText(4, u"/"_s);
+            } else {
+                top_item->setText(3,
+                                  QString::number(store.holdingRate(row) / 100.0, 'g', 2) % '%');
+                top_item->setText(4, store.isLimited(row) ? u"限量"_s : QString());
+            }
             tree_widget_->addTopLevelItem(top_item);
-            tree_widget_->setItemWidget(top_item, 0, new QLabel(u"典藏卡"_s));
-            tree_widget_->setItemWidget(top_item, 1,
-                                        new QLabel(collect.card_item->card_type_info->name));
-            tree_widget_->setItemWidget(
-                    top_item, 2,
-                    new QLabel(QString::number(
-                            collect.card_item->card_asset_info->card_item->total_cnt)));
-            tree_widget_->setItemWidget(top_item, 3, new QLabel(u"/"_s));
-            tree_widget_->setItemWidget(top_item, 4, new QLabel(u"/"_s));
-
-            if (collect.card_item->card_asset_info->card_item->card_id_list.has_value()) {
-                for (auto &&card :
-                     collect.card_item->card_asset_info->card_item->card_id_list.value()) {
-                    QTreeWidgetItem *sub_item = new QTreeWidgetItem(top_item);
-                    tree_widget_->setItemWidget(
-                            sub_item, 1, new QLabel(collect.card_item->card_type_info->name));
-                    tree_widget_->setItemWidget(sub_item, 2, new QLabel(card.card_no));
-                    tree_widget_->setItemWidget(
-                            sub_item, 5,
-                            new QLabel(card.card_right.is_transfer != 0 ? u"转赠中"_s : u""_s));
-                }
-                top_item->setExpanded(true);
+            top_item->setExpanded(store.cardBegin(row) != store.cardEnd(row));
+            pending_top_item_ = top_item;
+            pending_card_index_ = store.cardBegin(row);
+            ++populated_rows_;
+            return true;
+        }
+
+        if (pending_card_index_ < store.cardEnd(row)) {
+            const qsizetype i = pending_card_index_++;
+            QTreeWidgetItem *sub_item = new QTreeWidgetItem(pending_top_item_);
+            sub_item->setText(1, card_name);
+            sub_item->setText(2, store.cardNo(i).toString());
+            if (store.isTransfer(i)) {
+                sub_item->setText(5, u"转赠中"_s);
             }
+            ++populated_rows_;
+            return true;
         }
+
+        pending_top_item_ = nullptr;
+        ++pending_index_;
     }
 
-    tree_widget_->resizeColumnToContents(1);
-    tree_widget_->resizeColumnToContents(2);
+    return false;
 }
 
 void AssetBag::resizeEvent(QResizeEvent *event)
@@ -305,4 +436,6 @@ void AssetBag::resizeEvent(QResizeEvent *event)
     refresh_button_->move(tree_widget_->geometry().bottomLeft() + QPoint(0, 1));
     expand_all_button_->move(refresh_button_->geometry().topRight() + QPoint(1, 0));
     collapse_all_button_->move(expand_all_button_->geometry().topRight() + QPoint(1, 0));
+    progress_bar_->setGeometry(QRect(collapse_all_button_->geometry().topRight() + QPoint(5, 0),
+                                     QSize(200, collapse_all_button_->height())));
 }
\ No newline at end of file
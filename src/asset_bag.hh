@@ -10,16 +10,28 @@
 
 #include <optional>
 
+#include "card_store.hh"
+#include "interned_string.hh"
+
 QT_BEGIN_NAMESPACE
 class QLabel;
 class QTreeWidget;
+class QTreeWidgetItem;
 class QPushButton;
+class QProgressBar;
+class QTimer;
 QT_END_NAMESPACE
 
 // NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
 struct AssetBagData
 {
     static AssetBagData fromJson(const QByteArray &json, bool *ok = nullptr);
+    /// \brief 从已经解析的 data 字段构建，缺少字段或类型不符时抛出 nlohmann::json 的异常
+    ///
+    /// 只对 nlohmann::json 与 ArenaJson 实例化，CardStore::fromJson() 与 fromJson() 共用这一份解析。
+    template <typename BasicJsonType>
+    static AssetBagData fromJsonData(const BasicJsonType &data);
+    [[nodiscard]] static inline QString scarcityName(int card_scarcity);
 
     int total_item_cnt;
     int owned_item_cnt;
@@ -43,7 +55,7 @@ struct AssetBagData
         struct CardItem
         {
             long long card_type_id;
-            QString card_name;
+            InternedString card_name;
             QUrl card_img;
             int card_type;
             std::optional<QList<CardIdListItem>> card_id_list;
@@ -78,7 +90,7 @@ struct AssetBagData
             struct CardTypeInfo
             {
                 long long id;
-                QString name;
+                InternedString name;
                 QUrl overview_image;
                 int scarcity;
             };
@@ -116,6 +128,13 @@ public:
     [[nodiscard]] int lotteryId() const { return lottery_id_; }
     [[nodiscard]] QString actName() const { return act_name_; }
     [[nodiscard]] QString lotteryName() const { return lottery_name_; }
+    /// 树是否已经（或正在）填充
+    [[nodiscard]] bool isLoaded() const { return loaded_; }
+    /// 还有未填充的分片
+    [[nodiscard]] bool isPopulating() const;
+    [[nodiscard]] bool hasCardStore() const { return store_.typeCount() != 0; }
+    /// 近似的常驻内存字节数，卸载后只剩 CardStore
+    [[nodiscard]] qsizetype memoryUsage() const;
 
 signals:
     void refreshRequested(int act_id, const QString &act_name, int lottery_id,
@@ -128,12 +147,27 @@ public slots:
         setInfo(act_id, 0, act_name, QStringLiteral("全部奖池"));
     }
     void clearAssetBagData();
-    void setAssetBagData(const AssetBagData &data);
+    /// 分片填充，每次事件循环最多占用 kSliceBudget 毫秒，第一片立即显示
+    void setCardStore(const CardStore &store);
+    /// 释放树中的所有项，只保留 CardStore
+    void unload();
+    /// 从保留的 CardStore 重新填充
+    void reload();
+    /// 卸载后连 CardStore 也释放，之后需要通过 setCardStore() 重新设置
+    void releaseCardStore();
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
 
 private:
+    static constexpr int kSliceBudget = 8;
+    /// 每个 QTreeWidgetItem 连同各列数据的估计大小
+    static constexpr qsizetype kItemBytes = 384;
+
+    void populate();
+    void populateSlice();
+    bool populateNext();
+
     int act_id_;
     int lottery_id_; ///< 若为零则为全部奖池，否则为单奖池
     QString act_name_;
@@ -144,6 +178,14 @@ private:
     QPushButton *refresh_button_;
     QPushButton *expand_all_button_;
     QPushButton *collapse_all_button_;
+    QProgressBar *progress_bar_;
+    QTimer *populate_timer_;
+    CardStore store_;
+    bool loaded_;
+    qsizetype pending_index_;      ///< 当前卡片种类的行号
+    qsizetype pending_card_index_; ///< 下一张卡片在 store_ 中的下标
+    QTreeWidgetItem *pending_top_item_;
+    int populated_rows_;
 };
 
 // clang-format off
@@ -152,7 +194,12 @@ inline QString AssetBagData::ListItem::scarcity() const
     if (!card_item.has_value()) {
         return QStringLiteral("非卡片");
     }
-    switch (card_item->card_scarcity) {
+    return scarcityName(card_item->card_scarcity);
+}
+
+inline QString AssetBagData::scarcityName(int card_scarcity)
+{
+    switch (card_scarcity) {
     case 0: return QStringLiteral("典藏卡");
     case 10: return QStringLiteral("普卡");
     case 20: return QStringLiteral("稀缺");
@@ -0,0 +1,194 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <QRegularExpression>
+#include <QtLogging>
+#include <QDebug>
+
+#include "batch_export.hh"
+#include "collection_export_worker.hh"
+#include "compressed_file_writer.hh"
+
+using namespace Qt::Literals;
+
+BatchExportController::BatchExportController(QObject *parent)
+    : QObject(parent), writer_thread_(), writer_(new CompressedFileWriter), running_()
+{
+    writer_->moveToThread(&writer_thread_);
+}
+
+BatchExportController::~BatchExportController()
+{
+    cleanup();
+    writer_thread_.quit();
+    writer_thread_.wait();
+    delete writer_;
+}
+
+QList<ExportAccount> BatchExportController::readAccounts(const QString &file_name, bool *ok)
+{
+    if (ok) {
+        *ok = false;
+    }
+
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Unable to open file:" << file_name;
+        return {};
+    }
+
+    QList<ExportAccount> accounts;
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        const QStringList fields = line.split('\t');
+        if (std::size(fields) < 2 || fields[0].trimmed().isEmpty()) {
+            qWarning() << "Invalid account line:" << line.left(32);
+            continue;
+        }
+
+        ExportAccount account{ fields[0].trimmed(), fields[1].trimmed(), 300 };
+        if (std::size(fields) >= 3) {
+            bool interval_ok;
+            const int interval = fields[2].trimmed().toInt(&interval_ok);
+            if (interval_ok && interval > 0) {
+                account.request_interval = interval;
+            }
+        }
+        accounts.append(account);
+    }
+
+    if (ok) {
+        *ok = true;
+    }
+    return accounts;
+}
+
+QString BatchExportController::accountFileName(const QString &file_name,
+                                               const QString &account_name)
+{
+    static const QRegularExpression invalid_chars(uR"([\\/:*?"<>|\s])"_s);
+
+    const QFileInfo info(file_name);
+    QString base = info.fileName();
+    const QString suffix = QString(account_name).replace(invalid_chars, u"_"_s);
+    // 插入到第一个扩展名之前，保留 .csv.gz 这样的复合扩展名
+    const qsizetype pos = base.indexOf('.');
+    if (pos > 0) {
+        base.insert(pos, u"_"_s + suffix);
+    } else {
+        base.append(u"_"_s + suffix);
+    }
+    return info.dir().filePath(base);
+}
+
+void BatchExportController::exportToCsvFiles(const QList<ExportAccount> &accounts,
+                                             const QString &file_name, bool merged)
+{
+    cleanup();
+
+    if (accounts.isEmpty()) {
+        emit finished();
+        return;
+    }
+
+    if (merged) {
+        // 分别导出时每个账号的 CollectionExportWorker 自己写文件，不需要共享的写入线程
+        if (!writer_thread_.isRunning()) {
+            writer_thread_.start();
+        }
+        bool ok = false;
+        QMetaObject::invokeMethod(writer_, &CompressedFileWriter::open,
+                                  Qt::BlockingQueuedConnection, qReturnArg(ok), file_name, false);
+        if (!ok) {
+            emit errorOccurred(QString(), u"无法打开文件: %1"_s.arg(file_name));
+            emit finished();
+            return;
+        }
+        QMetaObject::invokeMethod(writer_, &CompressedFileWriter::write,
+                                  CollectionExportWorker::csvHeader(true));
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-narrowing-conversions)
+    running_ = std::size(accounts);
+    for (auto &&account : accounts) {
+        QThread *thread = new QThread;
+        CollectionExportWorker *worker = new CollectionExportWorker;
+        worker->setRequestInterval(account.request_interval);
+        if (merged) {
+            worker->setAccountName(account.name);
+            connect(worker, &CollectionExportWorker::writeRequested, writer_,
+                    &CompressedFileWriter::write);
+        }
+        worker->moveToThread(thread);
+
+        connect(worker, &CollectionExportWorker::progressChanged, this,
+                [this, name = account.name](int current, int total) {
+                    emit progressChanged(name, current, total);
+                });
+        connect(worker, &CollectionExportWorker::errorOccurred, this,
+                [this, name = account.name](const QString &message) {
+                    emit errorOccurred(name, message);
+                });
+        connect(worker, &CollectionExportWorker::finished, this,
+                &BatchExportController::onWorkerFinished);
+
+        thread->start();
+        sessions_.append(Session{ thread, worker });
+
+        if (merged) {
+            QMetaObject::invokeMethod(worker, &CollectionExportWorker::exportToSink,
+                                      account.cookie);
+        } else {
+            QMetaObject::invokeMethod(worker, &CollectionExportWorker::exportToCsvFile,
+                                      accountFileName(file_name, account.name), account.cookie);
+        }
+    }
+}
+
+void BatchExportController::stopAction()
+{
+    cleanup();
+    closeWriter();
+}
+
+void BatchExportController::onWorkerFinished()
+{
+    if (--running_ > 0) {
+        return;
+    }
+
+    // 所有账号的数据都已排队写入，关闭共享文件
+    closeWriter();
+    emit finished();
+}
+
+void BatchExportController::closeWriter()
+{
+    // 写入线程没有启动时 BlockingQueuedConnection 会一直等待
+    if (!writer_thread_.isRunning()) {
+        return;
+    }
+    QMetaObject::invokeMethod(writer_, &CompressedFileWriter::close,
+                              Qt::BlockingQueuedConnection);
+}
+
+void BatchExportController::cleanup()
+{
+    for (auto &&session : sessions_) {
+        QMetaObject::invokeMethod(session.worker, &CollectionExportWorker::stopAction,
+                                  Qt::BlockingQueuedConnection);
+        session.thread->quit();
+        session.thread->wait();
+        // 线程已经结束，可以在当前线程销毁
+        delete session.worker;
+        delete session.thread;
+    }
+    sessions_.clear();
+    running_ = 0;
+}
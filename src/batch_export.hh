@@ -0,0 +1,65 @@
+#ifndef BATCH_EXPORT_HH
+#define BATCH_EXPORT_HH
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QThread>
+
+class CollectionExportWorker;
+class CompressedFileWriter;
+
+struct ExportAccount
+{
+    QString name;
+    QString cookie;
+    int request_interval; ///< 毫秒，每个账号单独的频率限制
+};
+
+/// \brief 多账号并发导出，每个账号有独立的 CollectionExportWorker、线程和 Cookie
+///
+/// 总耗时接近最慢的账号，而不是所有账号之和。
+class BatchExportController : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BatchExportController(QObject *parent = nullptr);
+    ~BatchExportController() override;
+
+    /// \brief 读取账号列表，每行为 `名称<Tab>Cookie[<Tab>请求间隔毫秒]`，# 开头的行为注释
+    [[nodiscard]] static QList<ExportAccount> readAccounts(const QString &file_name,
+                                                           bool *ok = nullptr);
+    /// \brief a.csv.gz 对应账号 x 的文件为 a_x.csv.gz
+    [[nodiscard]] static QString accountFileName(const QString &file_name,
+                                                 const QString &account_name);
+
+public slots:
+    /// \param merged 为 true 时写入同一个文件并添加账号列，否则每个账号一个文件
+    void exportToCsvFiles(const QList<ExportAccount> &accounts, const QString &file_name,
+                          bool merged);
+    void stopAction();
+
+signals:
+    void progressChanged(const QString &account_name, int current, int total);
+    void errorOccurred(const QString &account_name, const QString &message);
+    void finished();
+
+private:
+    void onWorkerFinished();
+    void cleanup();
+    void closeWriter();
+
+    struct Session
+    {
+        QThread *thread;
+        CollectionExportWorker *worker;
+    };
+
+    QList<Session> sessions_;
+    QThread writer_thread_; ///< 第一次合并导出时启动
+    CompressedFileWriter *writer_; ///< 合并导出时共享
+    int running_;
+};
+
+#endif
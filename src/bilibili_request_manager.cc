@@ -1,25 +1,36 @@
 #include <QNetworkAccessManager>
+#include <QHostAddress>
 #include <QHttpHeaders>
 #include <QUrl>
 #include <QUrlQuery>
 #include <QScopedPointer>
+#include <QElapsedTimer>
 #include <QtLogging>
 #include <QDebug>
 #include <QtAssert>
 
+#include <memory>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
 #include "bilibili_request_manager.hh"
 #include "compress_helper.hh"
+#include "trace.hh"
+#include "request_metrics.hh"
 
 using namespace Qt::Literals;
 
 BilibiliRequestManager::BilibiliRequestManager(QObject *parent)
     : QObject(parent),
       manager_(new QNetworkAccessManager(this)),
-      factory_(QUrl(u"https://api.bilibili.com"_s)),
+      factory_(defaultBaseUrl()),
       user_agent_(u"Mozilla/5.0 (Windows NT 10.0; Win64; x64) "
                   "AppleWebKit/537.36 (KHTML, like Gecko) "
                   "Chrome/139.0.0.0 "
-                  "Safari/537.36"_s)
+                  "Safari/537.36"_s),
+      store_(),
+      offline_()
 {
     // 默认构造不会配置 cookie，使用默认的 UA
     QHttpHeaders headers;
@@ -30,6 +41,41 @@ BilibiliRequestManager::BilibiliRequestManager(QObject *parent)
     connect(manager_, &QNetworkAccessManager::sslErrors, this, &BilibiliRequestManager::sslErrors);
 }
 
+QUrl BilibiliRequestManager::defaultBaseUrl()
+{
+    const QString url = qEnvironmentVariable("BILIBILICARDBROWSER_API_URL");
+    if (url.isEmpty()) {
+        return QUrl(kBaseUrl);
+    }
+    if (!isLoopback(QUrl(url))) {
+        qWarning() << "Ignoring non-loopback API base URL:" << url;
+        return QUrl(kBaseUrl);
+    }
+    qInfo() << "Using API base URL:" << url;
+    return QUrl(url);
+}
+
+bool BilibiliRequestManager::isLoopback(const QUrl &url)
+{
+    const QString host = url.host();
+    return host.compare(u"localhost"_s, Qt::CaseInsensitive) == 0
+            || QHostAddress(host).isLoopback();
+}
+
+void BilibiliRequestManager::setBaseUrl(const QUrl &url)
+{
+    if (url != QUrl(kBaseUrl) && !isLoopback(url)) {
+        qWarning() << "Ignoring non-loopback API base URL:" << url;
+        return;
+    }
+    factory_.setBaseUrl(url);
+}
+
+bool BilibiliRequestManager::isBaseUrlOverridden() const
+{
+    return factory_.baseUrl() != QUrl(kBaseUrl);
+}
+
 void BilibiliRequestManager::setUserAgent(const QString &user_agent)
 {
     user_agent_ = user_agent;
@@ -74,48 +120,241 @@ void BilibiliRequestManager::setCookie(const QString &cookie)
     factory_.setCommonHeaders(headers);
 }
 
+bool BilibiliRequestManager::isConnectivityError(QNetworkReply::NetworkError error)
+{
+    switch (error) {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::HostNotFoundError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::UnknownNetworkError:
+    case QNetworkReply::ProxyConnectionRefusedError:
+    case QNetworkReply::ProxyNotFoundError:
+    case QNetworkReply::ProxyTimeoutError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+namespace {
+
+/// \brief 只读取顶层的 code，读到后立即停止，不构建 DOM
+class CodeReader : public nlohmann::json_sax<nlohmann::json>
+{
+public:
+    int code = -1;
+
+    bool null() override { return value(); }
+    bool boolean(bool) override { return value(); }
+    bool number_integer(number_integer_t val) override { return setCode(val); }
+    bool number_unsigned(number_unsigned_t val) override { return setCode(val); }
+    bool number_float(number_float_t, const string_t &) override { return value(); }
+    bool string(string_t &) override { return value(); }
+    bool binary(binary_t &) override { return value(); }
+    bool start_object(std::size_t) override { return enter(); }
+    bool key(string_t &val) override
+    {
+        is_code_ = depth_ == 1 && val == "code";
+        return true;
+    }
+    bool end_object() override { return leave(); }
+    bool start_array(std::size_t) override { return enter(); }
+    bool end_array() override { return leave(); }
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &) override
+    {
+        return false;
+    }
+
+private:
+    bool value()
+    {
+        is_code_ = false;
+        return true;
+    }
+    bool enter()
+    {
+        is_code_ = false;
+        ++depth_;
+        return true;
+    }
+    bool leave()
+    {
+        --depth_;
+        return true;
+    }
+    template<typename T>
+    bool setCode(T val)
+    {
+        if (!is_code_) {
+            return true;
+        }
+        code = static_cast<int>(val);
+        return false;
+    }
+
+    int depth_ = 0;
+    bool is_code_ = false;
+};
+
+/// 响应中的 code，无法解析时为 -1
+int peekCode(const QByteArray &json)
+{
+    CodeReader reader;
+    nlohmann::json::sax_parse(json.cbegin(), json.cend(), &reader);
+    return reader.code;
+}
+
+} // namespace
+
+void BilibiliRequestManager::trackReply(QNetworkReply *reply, const QString &endpoint)
+{
+    struct Timing
+    {
+        QElapsedTimer timer;
+        qint64 request_sent = -1;
+        qint64 first_byte = -1;
+    };
+    auto timing = std::make_shared<Timing>();
+    timing->timer.start();
+
+    connect(reply, &QNetworkReply::requestSent, this, [timing]() {
+        if (timing->request_sent < 0) {
+            timing->request_sent = timing->timer.nsecsElapsed();
+        }
+    });
+    connect(reply, &QNetworkReply::metaDataChanged, this, [timing]() {
+        if (timing->first_byte < 0) {
+            timing->first_byte = timing->timer.nsecsElapsed();
+        }
+    });
+    // 先于请求自己的 finished 连接，此时响应还没有被读取
+    connect(reply, &QNetworkReply::finished, this, [reply, endpoint, timing]() {
+        RequestMetrics::instance().recordReply(
+                endpoint,
+                RequestMetrics::ReplySample{ timing->request_sent, timing->first_byte,
+                                             timing->timer.nsecsElapsed(),
+                                             reply->bytesAvailable(), reply->error() });
+    });
+}
+
+template<typename Deliver>
+bool BilibiliRequestManager::serveFromCache(const QString &key, Deliver deliver)
+{
+    QByteArray data;
+    QByteArray content_encoding;
+    QDateTime fetched_at;
+    if (!store_.load(key, &data, &content_encoding, &fetched_at)) {
+        qWarning() << "Not cached:" << key;
+        emit cacheMissed(key);
+        return false;
+    }
+    emit cachedDataServed(key, fetched_at);
+    deliver(data, content_encoding);
+    return true;
+}
+
 void BilibiliRequestManager::getMyDecompose(int scene)
 {
+    const auto deliver = [this, scene](const QByteArray &data,
+                                       const QByteArray &content_encoding) {
+        deliverMyDecompose(scene, data, content_encoding, 0, false);
+    };
+    if (offline_) {
+        serveFromCache(OfflineStore::myDecomposeKey(scene), deliver);
+        return;
+    }
+
     QNetworkRequest request = factory_.createRequest(u"/x/vas/smelt/my_decompose/info"_s,
                                                      QUrlQuery{
                                                              { u"csrf"_s, csrf_ },
                                                              { u"scene"_s, QString::number(scene) },
                                                      });
+    QElapsedTimer timer;
+    timer.start();
     QNetworkReply *reply = manager_->get(request);
+    TRACE_ASYNC_BEGIN("network", "GET my_decompose", reinterpret_cast<quintptr>(reply));
+    trackReply(reply, RequestMetrics::kMyDecompose);
     connect(reply, &QNetworkReply::errorOccurred, this, [this](QNetworkReply::NetworkError error) {
         emit errorOccurred(qobject_cast<QNetworkReply *>(sender()), error);
     });
-    connect(reply, &QNetworkReply::finished, this, [this, scene]() {
+    connect(reply, &QNetworkReply::finished, this, [this, scene, timer, deliver]() {
         QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> reply(
                 qobject_cast<QNetworkReply *>(sender()));
         Q_ASSERT(reply != nullptr);
+        TRACE_ASYNC_END("network", "GET my_decompose", reinterpret_cast<quintptr>(reply.get()));
 
         if (reply->error() != QNetworkReply::NoError) {
+            if (isConnectivityError(reply->error())) {
+                serveFromCache(OfflineStore::myDecomposeKey(scene), deliver);
+            }
             return;
         }
 
+        const qint64 elapsed = timer.nsecsElapsed();
         const QByteArray data = reply->readAll();
-        const QHttpHeaders headers = reply->headers();
-
-        if (headers.contains(QHttpHeaders::WellKnownHeader::ContentEncoding)) {
-            bool ok;
-            const QByteArray uncompressed_data = uncompress(
-                    data, headers.value(QHttpHeaders::WellKnownHeader::ContentEncoding), &ok);
-            if (ok) {
-                emit myDecomposeDataReceived(scene, uncompressed_data);
-            } else {
-                qWarning() << "Unexpected Content-Encoding:"
-                           << headers.value(QHttpHeaders::WellKnownHeader::ContentEncoding);
+        const QByteArray content_encoding =
+                reply->headers()
+                        .value(QHttpHeaders::WellKnownHeader::ContentEncoding)
+                        .toByteArray();
+        deliverMyDecompose(scene, data, content_encoding, elapsed, !isBaseUrlOverridden());
+    });
+}
+
+void BilibiliRequestManager::deliverMyDecompose(int scene, const QByteArray &data,
+                                                const QByteArray &content_encoding,
+                                                qint64 elapsed, bool store)
+{
+    TRACE_SCOPE("network", "deliverMyDecompose");
+    if (!content_encoding.isEmpty()) {
+        bool ok;
+        QElapsedTimer decode_timer;
+        decode_timer.start();
+        const QByteArray uncompressed_data = uncompress(data, content_encoding, &ok);
+        if (ok) {
+            const qint64 decode = decode_timer.nsecsElapsed();
+            RequestMetrics::instance().recordDecompress(RequestMetrics::kMyDecompose, decode,
+                                                        std::size(uncompressed_data));
+            emit replyMeasured(u"/x/vas/smelt/my_decompose/info"_s, std::size(data),
+                               std::size(uncompressed_data), elapsed, decode);
+            // 只缓存 code 为 0 的响应，避免 -412 等错误覆盖之前的可用数据
+            if (store && peekCode(uncompressed_data) == 0) {
+                store_.store(OfflineStore::myDecomposeKey(scene), data, content_encoding);
             }
+            TRACE_FLOW_START("signal", "myDecomposeDataReceived", Trace::flowId(-1, scene));
+            emit myDecomposeDataReceived(scene, uncompressed_data);
         } else {
-            emit myDecomposeDataReceived(scene, data);
+            qWarning() << "Unexpected Content-Encoding:" << content_encoding;
         }
-    });
+    } else {
+        RequestMetrics::instance().recordDecompress(RequestMetrics::kMyDecompose, 0,
+                                                    std::size(data));
+        emit replyMeasured(u"/x/vas/smelt/my_decompose/info"_s, std::size(data), std::size(data),
+                           elapsed, 0);
+        if (store && peekCode(data) == 0) {
+            store_.store(OfflineStore::myDecomposeKey(scene), data, content_encoding);
+        }
+        TRACE_FLOW_START("signal", "myDecomposeDataReceived", Trace::flowId(-1, scene));
+        emit myDecomposeDataReceived(scene, data);
+    }
 }
 
 void BilibiliRequestManager::getAssetBag(int act_id, const QString &act_name, int lottery_id,
                                          int ruid)
 {
+    const auto deliver = [this, act_id, act_name, lottery_id, ruid](
+                                 const QByteArray &data, const QByteArray &content_encoding) {
+        deliverAssetBag(act_id, act_name, lottery_id, ruid, data, content_encoding, 0, false);
+    };
+    if (offline_) {
+        if (!serveFromCache(OfflineStore::assetBagKey(act_id, lottery_id), deliver)) {
+            emit assetBagRequestFailed(act_id, lottery_id);
+        }
+        return;
+    }
+
     QNetworkRequest request =
             factory_.createRequest(u"/x/vas/dlc_act/asset_bag"_s,
                                    QUrlQuery{
@@ -125,40 +364,94 @@ void BilibiliRequestManager::getAssetBag(int act_id, const QString &act_name, in
                                            { u"lottery_id"_s, QString::number(lottery_id) },
                                            { u"ruid"_s, QString::number(ruid) },
                                    });
+    QElapsedTimer timer;
+    timer.start();
     QNetworkReply *reply = manager_->get(request);
+    TRACE_ASYNC_BEGIN("network", "GET asset_bag", reinterpret_cast<quintptr>(reply));
+    trackReply(reply, RequestMetrics::kAssetBag);
     connect(reply, &QNetworkReply::errorOccurred, this, [this](QNetworkReply::NetworkError error) {
         emit errorOccurred(qobject_cast<QNetworkReply *>(sender()), error);
     });
-    connect(reply, &QNetworkReply::finished, this, [this, act_id, act_name, lottery_id, ruid]() {
-        QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> reply(
-                qobject_cast<QNetworkReply *>(sender()));
-        Q_ASSERT(reply != nullptr);
+    connect(reply, &QNetworkReply::finished, this,
+            [this, act_id, act_name, lottery_id, ruid, timer, deliver]() {
+                QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> reply(
+                        qobject_cast<QNetworkReply *>(sender()));
+                Q_ASSERT(reply != nullptr);
+                TRACE_ASYNC_END("network", "GET asset_bag",
+                                reinterpret_cast<quintptr>(reply.get()));
 
-        if (reply->error() != QNetworkReply::NoError) {
-            return;
-        }
+                if (reply->error() != QNetworkReply::NoError) {
+                    if (!isConnectivityError(reply->error())
+                        || !serveFromCache(OfflineStore::assetBagKey(act_id, lottery_id),
+                                           deliver)) {
+                        emit assetBagRequestFailed(act_id, lottery_id);
+                    }
+                    return;
+                }
 
-        const QByteArray data = reply->readAll();
-        const QHttpHeaders headers = reply->headers();
-
-        if (headers.contains(QHttpHeaders::WellKnownHeader::ContentEncoding)) {
-            bool ok;
-            const QByteArray uncompressed_data = uncompress(
-                    data, headers.value(QHttpHeaders::WellKnownHeader::ContentEncoding), &ok);
-            if (ok) {
-                emit assetBagDataReceived(act_id, act_name, lottery_id, ruid, uncompressed_data);
-            } else {
-                qWarning() << "Unexpected Content-Encoding:"
-                           << headers.value(QHttpHeaders::WellKnownHeader::ContentEncoding);
+                const qint64 elapsed = timer.nsecsElapsed();
+                const QByteArray data = reply->readAll();
+                const QByteArray content_encoding =
+                        reply->headers()
+                                .value(QHttpHeaders::WellKnownHeader::ContentEncoding)
+                                .toByteArray();
+                deliverAssetBag(act_id, act_name, lottery_id, ruid, data, content_encoding,
+                                elapsed, !isBaseUrlOverridden());
+            });
+}
+
+void BilibiliRequestManager::deliverAssetBag(int act_id, const QString &act_name, int lottery_id,
+                                             int ruid, const QByteArray &data,
+                                             const QByteArray &content_encoding, qint64 elapsed,
+                                             bool store)
+{
+    TRACE_SCOPE("network", "deliverAssetBag");
+    emit assetBagReplyReceived(act_id, lottery_id, data, content_encoding);
+
+    if (!content_encoding.isEmpty()) {
+        bool ok;
+        QElapsedTimer decode_timer;
+        decode_timer.start();
+        const QByteArray uncompressed_data = uncompress(data, content_encoding, &ok);
+        if (ok) {
+            const qint64 decode = decode_timer.nsecsElapsed();
+            RequestMetrics::instance().recordDecompress(RequestMetrics::kAssetBag, decode,
+                                                        std::size(uncompressed_data));
+            emit replyMeasured(u"/x/vas/dlc_act/asset_bag"_s, std::size(data),
+                               std::size(uncompressed_data), elapsed, decode);
+            // 只缓存 code 为 0 的响应，避免 -412 等错误覆盖之前的可用数据
+            if (store && peekCode(uncompressed_data) == 0) {
+                store_.store(OfflineStore::assetBagKey(act_id, lottery_id), data,
+                             content_encoding);
             }
+            TRACE_FLOW_START("signal", "assetBagDataReceived", Trace::flowId(act_id, lottery_id));
+            emit assetBagDataReceived(act_id, act_name, lottery_id, ruid, uncompressed_data);
         } else {
-            emit assetBagDataReceived(act_id, act_name, lottery_id, ruid, data);
+            qWarning() << "Unexpected Content-Encoding:" << content_encoding;
+            emit assetBagRequestFailed(act_id, lottery_id);
         }
-    });
+    } else {
+        RequestMetrics::instance().recordDecompress(RequestMetrics::kAssetBag, 0, std::size(data));
+        emit replyMeasured(u"/x/vas/dlc_act/asset_bag"_s, std::size(data), std::size(data),
+                           elapsed, 0);
+        if (store && peekCode(data) == 0) {
+            store_.store(OfflineStore::assetBagKey(act_id, lottery_id), data, content_encoding);
+        }
+        TRACE_FLOW_START("signal", "assetBagDataReceived", Trace::flowId(act_id, lottery_id));
+        emit assetBagDataReceived(act_id, act_name, lottery_id, ruid, data);
+    }
 }
 
 void BilibiliRequestManager::getImage(long long card_type_id, const QUrl &url)
 {
+    const auto deliver = [this, card_type_id, url](const QByteArray &data, const QByteArray &) {
+        emit imageDataReceived(card_type_id, url, data);
+    };
+    if (offline_) {
+        serveFromCache(OfflineStore::imageKey(card_type_id), deliver);
+        return;
+    }
+
     QNetworkRequest request(url);
     {
         // 不需要 cookie
@@ -168,18 +461,26 @@ void BilibiliRequestManager::getImage(long long card_type_id, const QUrl &url)
         request.setHeaders(headers);
     }
     QNetworkReply *reply = manager_->get(request);
+    TRACE_ASYNC_BEGIN("network", "GET image", reinterpret_cast<quintptr>(reply));
+    trackReply(reply, RequestMetrics::kImage);
     connect(reply, &QNetworkReply::errorOccurred, this, [this](QNetworkReply::NetworkError error) {
         emit errorOccurred(qobject_cast<QNetworkReply *>(sender()), error);
     });
-    connect(reply, &QNetworkReply::finished, this, [this, card_type_id, url]() {
+    connect(reply, &QNetworkReply::finished, this, [this, card_type_id, url, deliver]() {
         QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> reply(
                 qobject_cast<QNetworkReply *>(sender()));
         Q_ASSERT(reply != nullptr);
+        TRACE_ASYNC_END("network", "GET image", reinterpret_cast<quintptr>(reply.get()));
 
         if (reply->error() != QNetworkReply::NoError) {
+            if (isConnectivityError(reply->error())) {
+                serveFromCache(OfflineStore::imageKey(card_type_id), deliver);
+            }
             return;
         }
 
-        emit imageDataReceived(card_type_id, url, reply->readAll());
+        const QByteArray image = reply->readAll();
+        store_.store(OfflineStore::imageKey(card_type_id), image, QByteArray());
+        emit imageDataReceived(card_type_id, url, image);
     });
 }
\ No newline at end of file
@@ -5,9 +5,12 @@
 #include <QByteArray>
 #include <QString>
 #include <QUrl>
+#include <QDateTime>
 #include <QNetworkRequestFactory>
 #include <QNetworkReply>
 
+#include "offline_store.hh"
+
 QT_BEGIN_NAMESPACE
 class QNetworkAccessManager;
 QT_END_NAMESPACE
@@ -19,6 +22,8 @@ class BilibiliRequestManager : public QObject
     Q_PROPERTY(QString cookie READ cookie WRITE setCookie)
     Q_PROPERTY(QString csrf READ csrf)
     Q_PROPERTY(QString buvid READ buvid)
+    Q_PROPERTY(bool offline READ isOffline WRITE setOffline)
+    Q_PROPERTY(QUrl baseUrl READ baseUrl WRITE setBaseUrl)
 
 public:
     explicit BilibiliRequestManager(QObject *parent = nullptr);
@@ -31,6 +36,22 @@ public:
     [[nodiscard]] QString csrf() const { return csrf_; }
     [[nodiscard]] QString buvid() const { return buvid_; }
 
+    /// 离线时不访问网络，所有请求都由缓存响应
+    void setOffline(bool offline) { offline_ = offline; }
+    [[nodiscard]] bool isOffline() const { return offline_; }
+
+    /// 只影响 my_decompose 与 asset_bag，图片使用响应中的完整 URL。
+    /// 请求总是带有 Cookie 与 csrf，因此除 https://api.bilibili.com 外只接受本机地址
+    void setBaseUrl(const QUrl &url);
+    [[nodiscard]] QUrl baseUrl() const { return factory_.baseUrl(); }
+    /// 设置了 BILIBILICARDBROWSER_API_URL 且指向本机时使用它（例如 benchmark/ 中的本地替身），
+    /// 否则为 https://api.bilibili.com
+    [[nodiscard]] static QUrl defaultBaseUrl();
+
+    /// 网络不可用（而不是服务器拒绝请求）时才退回到缓存，随后会发出 cachedDataServed 或
+    /// cacheMissed
+    [[nodiscard]] static bool isConnectivityError(QNetworkReply::NetworkError error);
+
 public slots:
     void getMyDecompose(int scene);
     void getAssetBag(int act_id, const QString &act_name) { getAssetBag(act_id, act_name, 0); }
@@ -40,24 +61,59 @@ public slots:
     }
     void getAssetBag(int act_id, const QString &act_name, int lottery_id, int ruid);
     void getImage(long long card_type_id, const QUrl &url);
+    /// 成功的响应写入该目录，离线或网络不可用时从中读取；为空则不缓存
+    void setCacheDirectory(const QString &dir) { store_.setDirectory(dir); }
 
 signals:
     void myDecomposeDataReceived(int scene, const QByteArray &json);
     void assetBagDataReceived(int act_id, const QString &act_name, int lottery_id, int ruid,
                               const QByteArray &json);
+    /// 在 assetBagDataReceived 之前发出未解压的原始响应，content_encoding 为空表示未压缩
+    void assetBagReplyReceived(int act_id, int lottery_id, const QByteArray &data,
+                               const QByteArray &content_encoding);
+    /// 请求失败且缓存中也没有，不会再有对应的 assetBagDataReceived
+    void assetBagRequestFailed(int act_id, int lottery_id);
     void imageDataReceived(long long card_type_id, const QUrl &url, const QByteArray &image);
+    /// 在对应的 *DataReceived 之前发出，elapsed/decode 单位为纳秒
+    void replyMeasured(const QString &path, qint64 received_bytes, qint64 decoded_bytes,
+                       qint64 elapsed, qint64 decode);
+
+    /// 在对应的 *DataReceived 之前发出，表示这次的数据来自缓存而非网络
+    void cachedDataServed(const QString &key, const QDateTime &fetched_at);
+    /// 离线或网络不可用时缓存中也没有，不会再有对应的 *DataReceived
+    void cacheMissed(const QString &key);
 
 signals:
     void errorOccurred(QNetworkReply *reply, QNetworkReply::NetworkError error);
     void sslErrors(QNetworkReply *reply, const QList<QSslError> &errors);
 
 private:
+    static inline const QString kBaseUrl = QStringLiteral("https://api.bilibili.com");
+
+    /// 指向替身时响应不写入缓存，以免覆盖真实账号的数据
+    [[nodiscard]] bool isBaseUrlOverridden() const;
+    /// localhost 或回环地址
+    [[nodiscard]] static bool isLoopback(const QUrl &url);
+    /// 记录请求各阶段的耗时与响应大小到 RequestMetrics
+    void trackReply(QNetworkReply *reply, const QString &endpoint);
+    /// 解码并发出信号，store 为 true 时只把 code 为 0 的响应写入缓存
+    void deliverMyDecompose(int scene, const QByteArray &data, const QByteArray &content_encoding,
+                            qint64 elapsed, bool store);
+    void deliverAssetBag(int act_id, const QString &act_name, int lottery_id, int ruid,
+                         const QByteArray &data, const QByteArray &content_encoding,
+                         qint64 elapsed, bool store);
+    /// 从缓存读取后交给 deliver，缓存中没有时发出 cacheMissed() 并返回 false
+    template<typename Deliver>
+    bool serveFromCache(const QString &key, Deliver deliver);
+
     QNetworkAccessManager *manager_;
     QNetworkRequestFactory factory_;
     QString user_agent_;
     QString cookie_;
     QString csrf_;
     QString buvid_;
+    OfflineStore store_;
+    bool offline_;
 };
 
 #endif
\ No newline at end of file
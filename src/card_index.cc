@@ -0,0 +1,182 @@
+#include <QSet>
+
+#include <algorithm>
+
+#include "card_index.hh"
+#include "card_store.hh"
+
+using namespace Qt::Literals;
+
+quint32 CardIndex::gramKey(QChar a, QChar b)
+{
+    return (static_cast<quint32>(a.unicode()) << 16) | b.unicode();
+}
+
+int CardIndex::addEntry(Entry entry)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-narrowing-conversions)
+    const int id = std::size(entries_);
+
+    const QString name = entry.card_name.toString().toCaseFolded();
+    for (qsizetype i = 0; i < std::size(name); ++i) {
+        const quint32 keys[] = {
+            gramKey(name[i]),
+            i + 1 < std::size(name) ? gramKey(name[i], name[i + 1]) : gramKey(name[i]),
+        };
+        for (const quint32 key : keys) {
+            Posting &posting = gram_index_[key];
+            // 同一个条目只记录一次，下标单调递增所以只需看最后一个
+            if (posting.isEmpty() || posting.constLast() != id) {
+                posting.append(id);
+            }
+        }
+    }
+    for (auto &&card_no : std::as_const(entry.card_no_list)) {
+        Posting &posting = card_no_index_[card_no];
+        if (posting.isEmpty() || posting.constLast() != id) {
+            posting.append(id);
+        }
+    }
+    card_type_index_[entry.card_type_id].append(id);
+    collection_index_[qMakePair(entry.act_id, entry.lottery_id)].append(id);
+
+    entries_.append(std::move(entry));
+    alive_.append(true);
+    ++alive_count_;
+    return id;
+}
+
+void CardIndex::update(int act_id, int lottery_id, const QString &act_name,
+                       const CardStore &store)
+{
+    remove(act_id, lottery_id);
+
+    const InternedString act(act_name);
+    for (qsizetype row = 0; row < store.typeCount(); ++row) {
+        Entry entry{ act_id,
+                     lottery_id,
+                     act,
+                     store.cardTypeId(row),
+                     store.cardName(row),
+                     store.scarcity(row),
+                     {} };
+        entry.card_no_list.reserve(store.cardEnd(row) - store.cardBegin(row));
+        for (qsizetype i = store.cardBegin(row); i < store.cardEnd(row); ++i) {
+            entry.card_no_list.append(store.cardNo(i).toString());
+        }
+        addEntry(std::move(entry));
+    }
+
+    // 被替换的条目只是标记为删除，过多时重建一次
+    if (std::size(entries_) - alive_count_ > qMax<qsizetype>(alive_count_, 1024)) {
+        compact();
+    }
+}
+
+void CardIndex::remove(int act_id, int lottery_id)
+{
+    const Posting ids = collection_index_.take(qMakePair(act_id, lottery_id));
+    for (const int id : ids) {
+        if (alive_[id]) {
+            alive_[id] = false;
+            --alive_count_;
+        }
+    }
+}
+
+void CardIndex::clear()
+{
+    entries_.clear();
+    alive_.clear();
+    alive_count_ = 0;
+    gram_index_.clear();
+    card_no_index_.clear();
+    card_type_index_.clear();
+    collection_index_.clear();
+}
+
+void CardIndex::compact()
+{
+    QList<Entry> entries;
+    entries.reserve(alive_count_);
+    for (qsizetype i = 0; i < std::size(entries_); ++i) {
+        if (alive_[i]) {
+            entries.append(std::move(entries_[i]));
+        }
+    }
+
+    clear();
+    for (auto &&entry : entries) {
+        addEntry(std::move(entry));
+    }
+}
+
+QList<CardIndex::Match> CardIndex::search(const QString &query, int limit) const
+{
+    QList<Match> res;
+    const QString q = query.trimmed();
+    if (q.isEmpty()) {
+        return res;
+    }
+
+    QSet<int> seen;
+    const auto add = [&](int id, const QString &card_no) {
+        if (std::size(res) >= limit || !alive_[id] || seen.contains(id)) {
+            return;
+        }
+        seen.insert(id);
+        res.append(Match{ &entries_[id], card_no });
+    };
+
+    // 精确匹配优先：卡片编号、card_type_id
+    for (const int id : card_no_index_.value(q)) {
+        add(id, q);
+    }
+    bool is_number;
+    const long long card_type_id = q.toLongLong(&is_number);
+    if (is_number) {
+        for (const int id : card_type_index_.value(card_type_id)) {
+            add(id, QString());
+        }
+    }
+
+    // 卡名：取查询的所有二元组（只有一个字时取一元组）对应的倒排表求交集
+    const QString name = q.toCaseFolded();
+    QList<const Posting *> postings;
+    if (std::size(name) == 1) {
+        auto iter = gram_index_.constFind(gramKey(name[0]));
+        postings.append(iter != gram_index_.constEnd() ? &iter.value() : nullptr);
+    } else {
+        for (qsizetype i = 0; i + 1 < std::size(name); ++i) {
+            auto iter = gram_index_.constFind(gramKey(name[i], name[i + 1]));
+            postings.append(iter != gram_index_.constEnd() ? &iter.value() : nullptr);
+        }
+    }
+    if (std::any_of(postings.cbegin(), postings.cend(),
+                    [](const Posting *posting) { return posting == nullptr; })) {
+        return res;
+    }
+    std::sort(postings.begin(), postings.end(), [](const Posting *lhs, const Posting *rhs) {
+        return std::size(*lhs) < std::size(*rhs);
+    });
+
+    for (const int id : *postings.constFirst()) {
+        if (std::size(res) >= limit) {
+            break;
+        }
+        if (!alive_[id]) {
+            continue;
+        }
+        const bool in_all = std::all_of(postings.cbegin() + 1, postings.cend(),
+                                        [id](const Posting *posting) {
+                                            return std::binary_search(posting->cbegin(),
+                                                                      posting->cend(), id);
+                                        });
+        // 二元组都出现不代表连续出现，最后再确认一次
+        if (in_all && entries_[id].card_name.toString().contains(q, Qt::CaseInsensitive)) {
+            add(id, QString());
+        }
+    }
+
+    return res;
+}
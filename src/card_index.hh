@@ -0,0 +1,62 @@
+#ifndef CARD_INDEX_HH
+#define CARD_INDEX_HH
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QPair>
+
+#include "interned_string.hh"
+
+class CardStore;
+
+/// \brief 所有已加载收藏集中卡片的内存索引
+///
+/// 卡名按字符的一元/二元组建立倒排表，卡片编号与 card_type_id 为精确索引。
+/// 每收到一个收藏集就增量更新对应收藏集的条目，查询时不需要重新遍历解析结果。
+class CardIndex
+{
+public:
+    struct Entry
+    {
+        int act_id;
+        int lottery_id;
+        InternedString act_name;
+        long long card_type_id;
+        InternedString card_name;
+        InternedString scarcity;
+        QStringList card_no_list; ///< 拥有的卡片编号
+    };
+
+    struct Match
+    {
+        const Entry *entry; ///< 在下一次修改索引之前有效
+        QString card_no; ///< 按编号精确匹配时为对应编号，否则为空
+    };
+
+    void update(int act_id, int lottery_id, const QString &act_name, const CardStore &store);
+    void remove(int act_id, int lottery_id);
+    void clear();
+
+    /// 结果按收藏集加载顺序排列，最多 limit 条
+    [[nodiscard]] QList<Match> search(const QString &query, int limit = 200) const;
+    [[nodiscard]] qsizetype size() const { return alive_count_; }
+
+private:
+    using Posting = QList<int>; ///< 升序的条目下标
+
+    static quint32 gramKey(QChar a, QChar b = QChar());
+    int addEntry(Entry entry);
+    void compact();
+
+    QList<Entry> entries_;
+    QList<bool> alive_;
+    qsizetype alive_count_ = 0;
+    QHash<quint32, Posting> gram_index_;
+    QHash<QString, Posting> card_no_index_;
+    QHash<long long, Posting> card_type_index_;
+    QHash<QPair<int, int>, Posting> collection_index_; ///< {(act_id, lottery_id), 条目}
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include <QLineEdit>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QTreeWidgetItem>
+#include <QElapsedTimer>
+#include <QResizeEvent>
+
+#include "card_search.hh"
+#include "card_index.hh"
+
+using namespace Qt::Literals;
+
+CardSearch::CardSearch(QWidget *parent, Qt::WindowFlags f)
+    : QWidget(parent, f),
+      index_(),
+      line_edit_(new QLineEdit(this)),
+      result_label_(new QLabel(this)),
+      tree_widget_(new QTreeWidget(this))
+{
+    line_edit_->setPlaceholderText(u"搜索卡名/编号/card_type_id"_s);
+    line_edit_->setClearButtonEnabled(true);
+    line_edit_->adjustSize();
+    result_label_->adjustSize();
+
+    tree_widget_->setColumnCount(4);
+    tree_widget_->setHeaderLabels(QStringList{
+            u"收藏集"_s,
+            u"稀有度"_s,
+            u"名称"_s,
+            u"数量/编号"_s,
+    });
+    tree_widget_->setRootIsDecorated(false);
+
+    connect(line_edit_, &QLineEdit::textChanged, this, &CardSearch::refresh);
+    connect(tree_widget_, &QTreeWidget::itemDoubleClicked, this,
+            [this](QTreeWidgetItem *item, [[maybe_unused]] int column) {
+                emit collectionRequested(item->data(0, Qt::UserRole).toInt(), item->text(0),
+                                         item->data(0, Qt::UserRole + 1).toInt());
+            });
+}
+
+void CardSearch::refresh()
+{
+    tree_widget_->clear();
+    result_label_->clear();
+    if (index_ == nullptr || line_edit_->text().trimmed().isEmpty()) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const QList<CardIndex::Match> matches = index_->search(line_edit_->text());
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    QList<QTreeWidgetItem *> items;
+    items.reserve(std::size(matches));
+    for (auto &&match : matches) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(QStringList{
+                match.entry->act_name.toString(),
+                match.entry->scarcity.toString(),
+                match.entry->card_name.toString(),
+                match.card_no.isEmpty() ? QString::number(std::size(match.entry->card_no_list))
+                                        : match.card_no,
+        });
+        item->setData(0, Qt::UserRole, match.entry->act_id);
+        item->setData(0, Qt::UserRole + 1, match.entry->lottery_id);
+        items.append(item);
+    }
+    tree_widget_->addTopLevelItems(items);
+
+    result_label_->setText(u"%1 个结果（共 %2 种卡片，%3 ms）"_s.arg(std::size(matches))
+                                   .arg(index_->size())
+                                   .arg(QString::number(elapsed / 1e6, 'f', 2)));
+    result_label_->adjustSize();
+}
+
+void CardSearch::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    const QSize size = event->size();
+    line_edit_->resize(size.width(), line_edit_->height());
+    result_label_->move(line_edit_->geometry().bottomLeft() + QPoint(0, 1));
+    tree_widget_->move(result_label_->geometry().bottomLeft() + QPoint(0, 1));
+    tree_widget_->resize(size.width(), size.height() - tree_widget_->y());
+}
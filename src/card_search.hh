@@ -0,0 +1,42 @@
+#ifndef CARD_SEARCH_HH
+#define CARD_SEARCH_HH
+
+#include <QWidget>
+#include <QString>
+
+QT_BEGIN_NAMESPACE
+class QLineEdit;
+class QLabel;
+class QTreeWidget;
+QT_END_NAMESPACE
+
+class CardIndex;
+
+/// \brief 在所有已加载的收藏集中搜索卡名、卡片编号或 card_type_id
+class CardSearch : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit CardSearch(QWidget *parent = nullptr, Qt::WindowFlags f = Qt::WindowFlags());
+
+    void setIndex(const CardIndex *index) { index_ = index; }
+
+signals:
+    void collectionRequested(int act_id, const QString &act_name, int lottery_id);
+
+public slots:
+    /// 索引更新后重新执行当前的查询
+    void refresh();
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    const CardIndex *index_;
+    QLineEdit *line_edit_;
+    QLabel *result_label_;
+    QTreeWidget *tree_widget_;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include <QtLogging>
+#include <QDebug>
+
+#include "card_store.hh"
+#include "asset_bag.hh"
+#include "json_arena.hh"
+#include "json_helper.hh"
+#include "trace.hh"
+#include "allocation_accounting.hh"
+
+using namespace Qt::Literals;
+
+CardStore CardStore::fromAssetBagData(const AssetBagData &data)
+{
+    CardStore store;
+    store.owned_item_cnt_ = data.owned_item_cnt;
+    store.total_item_cnt_ = data.total_item_cnt;
+    store.card_offset_.append(0);
+    store.card_no_offset_.append(0);
+
+    if (data.item_list.has_value()) {
+        for (auto &&item : data.item_list.value()) {
+            if (!item.card_item.has_value()) {
+                continue;
+            }
+            const auto &card_item = item.card_item.value();
+            if (card_item.card_id_list.has_value()) {
+                for (auto &&card : card_item.card_id_list.value()) {
+                    store.appendCard(card.card_id, card.card_no, card.status,
+                                     card.card_right.is_transfer != 0 ? Transfer : 0);
+                }
+            }
+            store.appendType(card_item.card_type_id, card_item.card_name,
+                             card_item.card_img.toString(), card_item.card_scarcity,
+                             card_item.total_cnt, card_item.holding_rate,
+                             card_item.is_limited_card != 0 ? Limited : 0);
+        }
+    }
+
+    if (data.collect_list.has_value()) {
+        for (auto &&collect : data.collect_list.value()) {
+            if (!collect.card_item.has_value() || !collect.card_item->card_type_info.has_value()) {
+                continue;
+            }
+            const auto &card_type_info = collect.card_item->card_type_info.value();
+            int total_cnt = 0;
+            if (collect.card_item->card_asset_info.has_value()
+                && collect.card_item->card_asset_info->card_item.has_value()) {
+                const auto &card_item = collect.card_item->card_asset_info->card_item.value();
+                total_cnt = card_item.total_cnt;
+                if (card_item.card_id_list.has_value()) {
+                    for (auto &&card : card_item.card_id_list.value()) {
+                        store.appendCard(card.card_id, card.card_no, card.status,
+                                         card.card_right.is_transfer != 0 ? Transfer : 0);
+                    }
+                }
+            }
+            store.appendType(card_type_info.id, card_type_info.name,
+                             card_type_info.overview_image.toString(), card_type_info.scarcity,
+                             total_cnt, 0, Collect);
+        }
+    }
+
+    store.squeeze();
+    return store;
+}
+
+CardStore CardStore::fromJson(const QByteArray &json, bool *ok, int *code_out)
+{
+    TRACE_SCOPE("parse", "CardStore::fromJson");
+    ALLOCATION_SCOPE(JsonParse);
+    if (ok) {
+        *ok = false;
+    }
+    if (code_out) {
+        *code_out = -1;
+    }
+
+    CardStore store;
+    // DOM 与其中的字符串都在分配区中，返回时只留下各列
+    JsonArena arena(std::size(json) * 4);
+    const ArenaJson j = ArenaJson::parse(json.cbegin(), json.cend(), nullptr, false);
+    if (j.is_discarded()) {
+        return store;
+    }
+
+    try {
+        const int code = j.at("code").get<int>();
+        if (code_out) {
+            *code_out = code;
+        }
+        const QString message = j.at("message").get<QString>();
+        if (code != 0) {
+            qWarning() << "code:" << code << "message:" << message;
+            return store;
+        }
+
+        auto &&data = j.at("data");
+        if (!data.is_object()) {
+            return store;
+        }
+
+        // 与 AssetBagData::fromJson() 共用同一份 from_json，只有 DOM 分配在分配区中
+        store = fromAssetBagData(AssetBagData::fromJsonData(data));
+        if (ok) {
+            *ok = true;
+        }
+        return store;
+    } catch (const ArenaJson::exception &e) {
+        // 缺少字段或类型不符时 at() 与 get() 仍然会抛出异常，与解析失败同样处理
+        qWarning() << "Invalid response:" << e.what();
+        if (code_out) {
+            *code_out = -1;
+        }
+        return CardStore();
+    }
+}
+
+InternedString CardStore::scarcity(qsizetype row) const
+{
+    // 稀有度只有几种，第一次用到时放入全局表
+    static const InternedString collect(u"典藏卡"_s);
+    static const InternedString labels[] = {
+        InternedString(AssetBagData::scarcityName(0)),
+        InternedString(AssetBagData::scarcityName(10)),
+        InternedString(AssetBagData::scarcityName(20)),
+        InternedString(AssetBagData::scarcityName(30)),
+        InternedString(AssetBagData::scarcityName(40)),
+    };
+    if (isCollect(row)) {
+        return collect;
+    }
+    const int scarcity = scarcity_[row];
+    if (scarcity >= 0 && scarcity <= 40 && scarcity % 10 == 0) {
+        return labels[scarcity / 10];
+    }
+    return InternedString(AssetBagData::scarcityName(scarcity));
+}
+
+qsizetype CardStore::memoryUsage() const
+{
+    // 卡名在全局表中共享，这里只计句柄
+    qsizetype bytes = sizeof(CardStore);
+    for (auto &&image : image_) {
+        bytes += image.capacity() * sizeof(QChar);
+    }
+    bytes += type_id_.capacity() * sizeof(qint64) + name_.capacity() * sizeof(InternedString)
+            + image_.capacity() * sizeof(QString) + scarcity_.capacity() * sizeof(qint8)
+            + total_cnt_.capacity() * sizeof(qint32) + holding_rate_.capacity() * sizeof(qint16)
+            + type_flags_.capacity() * sizeof(quint8) + card_offset_.capacity() * sizeof(quint32);
+    bytes += card_id_.capacity() * sizeof(qint64) + card_no_.capacity() * sizeof(QChar)
+            + card_no_offset_.capacity() * sizeof(quint32) + status_.capacity() * sizeof(qint16)
+            + card_flags_.capacity() * sizeof(quint8);
+    return bytes;
+}
+
+void CardStore::squeeze()
+{
+    // 各列收缩到实际大小
+    type_id_.squeeze();
+    name_.squeeze();
+    image_.squeeze();
+    scarcity_.squeeze();
+    total_cnt_.squeeze();
+    holding_rate_.squeeze();
+    type_flags_.squeeze();
+    card_offset_.squeeze();
+    card_id_.squeeze();
+    card_no_.squeeze();
+    card_no_offset_.squeeze();
+    status_.squeeze();
+    card_flags_.squeeze();
+}
+
+void CardStore::appendType(long long id, InternedString name, const QString &image, int scarcity,
+                           int total_cnt, int holding_rate, quint8 flags)
+{
+    type_id_.append(id);
+    name_.append(name);
+    image_.append(image);
+    scarcity_.append(static_cast<qint8>(scarcity));
+    total_cnt_.append(total_cnt);
+    holding_rate_.append(static_cast<qint16>(holding_rate)); // 最大为 10000
+    type_flags_.append(flags);
+    // 该种类的卡片已经在此之前追加完毕
+    card_offset_.append(static_cast<quint32>(std::size(card_id_)));
+}
+
+void CardStore::appendCard(long long id, const QString &card_no, int status, quint8 flags)
+{
+    card_id_.append(id);
+    card_no_.append(card_no);
+    card_no_offset_.append(static_cast<quint32>(std::size(card_no_)));
+    status_.append(static_cast<qint16>(status));
+    card_flags_.append(flags);
+}
@@ -0,0 +1,92 @@
+#ifndef CARD_STORE_HH
+#define CARD_STORE_HH
+
+#include <QByteArray>
+#include <QString>
+#include <QStringView>
+#include <QList>
+#include <QMetaType>
+
+#include "interned_string.hh"
+
+struct AssetBagData;
+
+/// \brief 一个收藏集的卡片数据，按列存储
+///
+/// 每种卡片（包括典藏卡）占一行，卡名为全局字符串表中的句柄，其余字段为紧凑的整数列；
+/// 拥有的卡片按种类连续存放，卡片编号拼接在同一个字符串中。
+/// 所有成员都是隐式共享的容器，复制很便宜，可以直接跨线程传递。
+class CardStore
+{
+public:
+    enum Flag : quint8 {
+        Limited = 0x1, ///< 限量卡
+        Collect = 0x2, ///< 典藏卡，没有持有率与限量信息
+        Transfer = 0x4, ///< 单张卡片：转赠中
+    };
+
+    static CardStore fromAssetBagData(const AssetBagData &data);
+    /// 与 AssetBagData::fromJson() 相同的解析，但 DOM 分配在 JsonArena 中
+    /// \param code 非空时设置响应中的 code，无法解析时为 -1
+    static CardStore fromJson(const QByteArray &json, bool *ok = nullptr, int *code = nullptr);
+
+    [[nodiscard]] int ownedItemCount() const { return owned_item_cnt_; }
+    [[nodiscard]] int totalItemCount() const { return total_item_cnt_; }
+
+    // 卡片种类
+    [[nodiscard]] qsizetype typeCount() const { return std::size(type_id_); }
+    [[nodiscard]] long long cardTypeId(qsizetype row) const { return type_id_[row]; }
+    [[nodiscard]] InternedString cardName(qsizetype row) const { return name_[row]; }
+    [[nodiscard]] const QString &cardImage(qsizetype row) const { return image_[row]; }
+    [[nodiscard]] int cardScarcity(qsizetype row) const { return scarcity_[row]; }
+    [[nodiscard]] InternedString scarcity(qsizetype row) const;
+    [[nodiscard]] int totalCount(qsizetype row) const { return total_cnt_[row]; }
+    [[nodiscard]] int holdingRate(qsizetype row) const { return holding_rate_[row]; }
+    [[nodiscard]] bool isLimited(qsizetype row) const { return (type_flags_[row] & Limited) != 0; }
+    [[nodiscard]] bool isCollect(qsizetype row) const { return (type_flags_[row] & Collect) != 0; }
+    /// 该种类拥有的卡片为 [cardBegin(row), cardEnd(row))
+    [[nodiscard]] qsizetype cardBegin(qsizetype row) const { return card_offset_[row]; }
+    [[nodiscard]] qsizetype cardEnd(qsizetype row) const { return card_offset_[row + 1]; }
+
+    // 拥有的卡片
+    [[nodiscard]] qsizetype cardCount() const { return std::size(card_id_); }
+    [[nodiscard]] long long cardId(qsizetype i) const { return card_id_[i]; }
+    [[nodiscard]] QStringView cardNo(qsizetype i) const
+    {
+        return QStringView(card_no_).sliced(card_no_offset_[i],
+                                            card_no_offset_[i + 1] - card_no_offset_[i]);
+    }
+    [[nodiscard]] int status(qsizetype i) const { return status_[i]; }
+    [[nodiscard]] bool isTransfer(qsizetype i) const { return (card_flags_[i] & Transfer) != 0; }
+
+    /// 近似的常驻内存字节数
+    [[nodiscard]] qsizetype memoryUsage() const;
+
+private:
+    void squeeze();
+    void appendType(long long id, InternedString name, const QString &image, int scarcity,
+                    int total_cnt, int holding_rate, quint8 flags);
+    void appendCard(long long id, const QString &card_no, int status, quint8 flags);
+
+    int owned_item_cnt_ = 0;
+    int total_item_cnt_ = 0;
+
+    QList<qint64> type_id_;
+    QList<InternedString> name_;
+    QList<QString> image_; ///< 图片地址几乎各不相同，不放入全局表
+    QList<qint8> scarcity_;
+    QList<qint32> total_cnt_;
+    QList<qint16> holding_rate_;
+    QList<quint8> type_flags_;
+    QList<quint32> card_offset_;
+
+    QList<qint64> card_id_;
+    QString card_no_;
+    QList<quint32> card_no_offset_;
+    QList<qint16> status_;
+    QList<quint8> card_flags_;
+};
+
+Q_DECLARE_METATYPE(CardStore)
+
+#endif
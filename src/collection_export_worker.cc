@@ -1,89 +1,415 @@
+#include <QStringList>
 #include <QFile>
-#include <QTextStream>
 #include <QtLogging>
 #include <QDebug>
 #include <QTimerEvent>
+#include <QUrlQuery>
 
+#include <algorithm>
 #include <chrono>
 
 #include "collection_export_worker.hh"
 #include "bilibili_request_manager.hh"
+#include "compressed_file_writer.hh"
+#include "response_archive.hh"
 #include "my_decompose.hh"
-#include "asset_bag.hh"
+#include "card_store.hh"
+#include "request_metrics.hh"
+#include "trace.hh"
+#include "allocation_accounting.hh"
 
 using namespace Qt::Literals;
 
+namespace {
+
+constexpr int kThrottledCode = -412;
+/// 连续被限流超过这个次数时放弃
+constexpr int kMaxThrottleRetries = 5;
+/// 毫秒，每次连续被限流时加倍
+constexpr int kThrottleBackoff = 5000;
+constexpr int kMaxThrottleBackoff = 60000;
+
+} // namespace
+
 CollectionExportWorker::CollectionExportWorker(QObject *parent)
     : QObject(parent),
       manager_(new BilibiliRequestManager(this)),
-      file_(new QFile(this)),
+      writer_thread_(),
+      writer_(new CompressedFileWriter),
+      archive_writer_(new CompressedFileWriter),
+      request_interval_(300),
+      exporting_(),
+      owns_file_(),
       timer_id_(Qt::TimerId::Invalid),
+      throttle_timer_id_(Qt::TimerId::Invalid),
+      throttle_count_(),
+      throttle_started_(),
       current_(),
-      total_()
+      total_(),
+      statistics_(),
+      last_reply_(),
+      export_timer_(),
+      last_completion_()
 {
     connect(manager_, &BilibiliRequestManager::myDecomposeDataReceived, this,
             &CollectionExportWorker::onMyDecomposeDataReceived);
     connect(manager_, &BilibiliRequestManager::assetBagDataReceived, this,
             &CollectionExportWorker::onAssetBagDataReceived);
+    connect(manager_, &BilibiliRequestManager::replyMeasured, this,
+            [this](const QString &path, qint64 received_bytes, qint64 decoded_bytes,
+                   qint64 elapsed, qint64 decode) {
+                ++statistics_.requests;
+                statistics_.received_bytes += received_bytes;
+                statistics_.decoded_bytes += decoded_bytes;
+                statistics_.latency += elapsed;
+                statistics_.decode += decode;
+                if (path.endsWith(u"asset_bag"_s)) {
+                    last_reply_.received_bytes = received_bytes;
+                    last_reply_.decoded_bytes = decoded_bytes;
+                    last_reply_.latency = elapsed;
+                    last_reply_.decode = decode;
+                }
+            });
+    connect(manager_, &BilibiliRequestManager::cacheMissed, this, [this](const QString &key) {
+        if (!exporting_) {
+            return;
+        }
+        emit errorOccurred(u"离线缓存中没有 %1"_s.arg(key));
+        stopAction();
+        emit finished();
+    });
+    connect(manager_, &BilibiliRequestManager::errorOccurred, this,
+            [this](QNetworkReply *reply, QNetworkReply::NetworkError error) {
+                if (!exporting_) {
+                    return;
+                }
+                if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 412
+                    && reply->url().path().endsWith(u"asset_bag"_s)) {
+                    onThrottled(QUrlQuery(reply->url()).queryItemValue(u"act_id"_s).toInt());
+                    return;
+                }
+                qWarning() << "Network error:" << error << reply->errorString();
+                // 网络不可用时改由缓存响应，缓存中没有时会收到 cacheMissed 并在那里停止
+                if (BilibiliRequestManager::isConnectivityError(error)) {
+                    return;
+                }
+                // 服务器拒绝请求时不会再收到对应的响应，继续等待只会卡住
+                emit errorOccurred(u"网络错误: %1"_s.arg(reply->errorString()));
+                stopAction();
+                emit finished();
+            });
+
+    writer_thread_.setObjectName(u"writer"_s);
+    writer_->moveToThread(&writer_thread_);
+    archive_writer_->moveToThread(&writer_thread_);
+    connect(this, &CollectionExportWorker::archiveWriteRequested, archive_writer_,
+            &CompressedFileWriter::write);
+}
+
+CollectionExportWorker::~CollectionExportWorker()
+{
+    writer_thread_.quit();
+    writer_thread_.wait();
+    // 线程已经结束，直接在当前线程关闭并销毁
+    delete writer_;
+    delete archive_writer_;
+}
+
+QByteArray CollectionExportWorker::csvHeader(bool with_account)
+{
+    QStringList header{ u"收藏集名"_s, u"卡名"_s, u"稀有度"_s, u"编号"_s, u"是否限量"_s, };
+    if (with_account) {
+        header.prepend(u"账号"_s);
+    }
+    return header.join(',').toUtf8() + '\n';
+}
+
+QByteArray CollectionExportWorker::formatCsvRows(const QString &act_name, const CardStore &store,
+                                                 const QString &account_name)
+{
+    TRACE_SCOPE("export", "formatCsvRows");
+    ALLOCATION_SCOPE(Export);
+    QString out;
+    const QString prefix = account_name.isEmpty() ? QString() : QString(account_name % ',');
+
+    for (qsizetype row = 0; row < store.typeCount(); ++row) {
+        const QString &card_name = store.cardName(row).toString();
+        const QString &scarcity = store.scarcity(row).toString();
+        const QString limited = !store.isCollect(row) && store.isLimited(row) ? u"限量"_s : u"/"_s;
+        for (qsizetype i = store.cardBegin(row); i < store.cardEnd(row); ++i) {
+            out += prefix % act_name % ',' % card_name % ',' % scarcity % ','
+                    % store.cardNo(i) % ',' % limited % '\n';
+        }
+    }
+
+    return out.toUtf8();
 }
 
 void CollectionExportWorker::exportToCsvFile(const QString &file_name, const QString &cookie)
 {
-    if (file_->isOpen()) {
-        file_->close();
+    resetStatistics();
+    if (!openFile(file_name)) {
+        emit errorOccurred(u"无法打开文件: %1"_s.arg(file_name));
+        emit finished();
+        return;
     }
-    file_->setFileName(file_name);
-    if (!file_->open(QIODevice::WriteOnly | QIODevice::Text)) {
-        qWarning() << "Unable to open file:" << file_name;
+
+    if (!archive_file_name_.isEmpty()) {
+        bool ok = false;
+        QMetaObject::invokeMethod(archive_writer_, &CompressedFileWriter::open,
+                                  Qt::BlockingQueuedConnection, qReturnArg(ok),
+                                  archive_file_name_, true);
+        if (!ok) {
+            qWarning() << "Unable to open archive:" << archive_file_name_;
+        }
+    }
+
+    manager_->setCookie(cookie);
+    manager_->getMyDecompose(1);
+}
+
+void CollectionExportWorker::exportArchiveToCsvFile(const QString &archive_file_name,
+                                                    const QString &file_name)
+{
+    bool ok;
+    const QList<ResponseArchiveRecord> records = readResponseArchive(archive_file_name, &ok);
+    if (!ok) {
+        emit errorOccurred(u"无法读取存档: %1"_s.arg(archive_file_name));
+        emit finished();
+        return;
+    }
+    if (!openFile(file_name)) {
+        emit errorOccurred(u"无法打开文件: %1"_s.arg(file_name));
+        emit finished();
         return;
     }
 
-    QTextStream out(file_);
-    out << QStringList{ u"收藏集名"_s, u"卡名"_s, u"稀有度"_s, u"编号"_s, u"是否限量"_s, }.join(',') << '\n';
+    resetStatistics();
+    current_ = 0;
+    // NOLINTNEXTLINE(cppcoreguidelines-narrowing-conversions)
+    total_ = std::size(records);
+    statistics_.total = total_;
+    for (auto &&record : records) {
+        QElapsedTimer timer;
+        timer.start();
+        const CardStore d = CardStore::fromJson(record.response, &ok);
+        const qint64 parse = timer.nsecsElapsed();
+        if (ok) {
+            timer.restart();
+            const QByteArray rows = formatCsvRows(record.act_name, d, account_name_);
+            const qint64 format = timer.nsecsElapsed();
+            emit writeRequested(rows);
+            last_reply_.decoded_bytes = std::size(record.response);
+            statistics_.decoded_bytes += std::size(record.response);
+            recordCollection(record.act_id, record.act_name, parse, format, rows);
+        } else {
+            qWarning() << "Skipping invalid archived response, act_id:" << record.act_id;
+        }
+        emit progressChanged(++current_, total_);
+    }
+
+    closeFile();
+    finishStatistics();
+    emit finished();
+}
+
+void CollectionExportWorker::setArchiveFileName(const QString &archive_file_name)
+{
+    archive_file_name_ = archive_file_name;
+}
+
+void CollectionExportWorker::setReportFileName(const QString &report_file_name)
+{
+    report_file_name_ = report_file_name;
+}
+
+void CollectionExportWorker::exportToSink(const QString &cookie)
+{
+    closeFile();
+    resetStatistics();
+    exporting_ = true;
+    owns_file_ = false;
+
+    // 数据行只发给调用方连接的文件，否则会堆积在没有启动的写入线程的事件队列中
+    disconnect(this, &CollectionExportWorker::writeRequested, writer_,
+               &CompressedFileWriter::write);
 
     manager_->setCookie(cookie);
     manager_->getMyDecompose(1);
 }
 
+void CollectionExportWorker::setAccountName(const QString &account_name)
+{
+    account_name_ = account_name;
+}
+
+void CollectionExportWorker::setRequestInterval(int msec)
+{
+    request_interval_ = msec;
+}
+
+void CollectionExportWorker::setOffline(bool offline)
+{
+    manager_->setOffline(offline);
+}
+
+void CollectionExportWorker::setCacheDirectory(const QString &dir)
+{
+    manager_->setCacheDirectory(dir);
+}
+
 void CollectionExportWorker::stopAction()
 {
     if (timer_id_ != Qt::TimerId::Invalid) {
         killTimer(timer_id_);
+        timer_id_ = Qt::TimerId::Invalid;
     }
-    if (file_->isOpen()) {
-        file_->close();
+    if (throttle_timer_id_ != Qt::TimerId::Invalid) {
+        killTimer(throttle_timer_id_);
+        throttle_timer_id_ = Qt::TimerId::Invalid;
     }
+    closeFile();
 
     current_ = 0;
     total_ = 0;
     my_decompose_data_.reset();
+    in_flight_.clear();
+}
+
+bool CollectionExportWorker::openFile(const QString &file_name)
+{
+    closeFile();
+
+    // exportToSink() 不写文件，直到第一次打开文件时才启动写入线程
+    if (!writer_thread_.isRunning()) {
+        writer_thread_.start();
+    }
+    bool ok = false;
+    QMetaObject::invokeMethod(writer_, &CompressedFileWriter::open, Qt::BlockingQueuedConnection,
+                              qReturnArg(ok), file_name, false);
+    if (!ok) {
+        return false;
+    }
+    exporting_ = true;
+    owns_file_ = true;
+    connect(this, &CollectionExportWorker::writeRequested, writer_, &CompressedFileWriter::write,
+            Qt::UniqueConnection);
+
+    emit writeRequested(csvHeader(!account_name_.isEmpty()));
+    return true;
+}
+
+void CollectionExportWorker::closeFile()
+{
+    if (!exporting_) {
+        return;
+    }
+    exporting_ = false;
+    if (!owns_file_) {
+        return;
+    }
+    // 之前排队的写入会先完成，返回时文件已经完整落盘
+    QMetaObject::invokeMethod(writer_, &CompressedFileWriter::close,
+                              Qt::BlockingQueuedConnection);
+    QMetaObject::invokeMethod(archive_writer_, &CompressedFileWriter::close,
+                              Qt::BlockingQueuedConnection);
+}
+
+void CollectionExportWorker::resetStatistics()
+{
+    statistics_ = ExportStatistics();
+    statistics_.request_interval = request_interval_;
+    last_reply_ = ExportStatistics::CollectionItem();
+    export_timer_.start();
+    last_completion_ = 0;
+    throttle_count_ = 0;
+}
+
+void CollectionExportWorker::recordCollection(int act_id, const QString &act_name, qint64 parse,
+                                              qint64 format, const QByteArray &rows)
+{
+    ExportStatistics::CollectionItem item = last_reply_;
+    item.act_id = act_id;
+    item.act_name = act_name;
+    item.parse = parse;
+    item.format = format;
+    // NOLINTNEXTLINE(cppcoreguidelines-narrowing-conversions)
+    item.rows = rows.count('\n');
+    last_reply_ = ExportStatistics::CollectionItem();
+
+    statistics_.parse += parse;
+    statistics_.format += format;
+    statistics_.rows += item.rows;
+    statistics_.collections.append(item);
+    statistics_.current = current_ + 1;
+
+    // 指数移动平均，比总平均更快地反映限流或网络变化
+    const qint64 now = export_timer_.nsecsElapsed();
+    const double interval = static_cast<double>(now - last_completion_);
+    statistics_.average_interval = statistics_.average_interval <= 0.0
+            ? interval
+            : 0.2 * interval + 0.8 * statistics_.average_interval;
+    last_completion_ = now;
+    statistics_.elapsed = now;
+
+    emit statisticsChanged(statistics_);
+}
+
+void CollectionExportWorker::finishStatistics()
+{
+    statistics_.elapsed = export_timer_.nsecsElapsed();
+    qInfo().noquote() << statistics_.summary();
+
+    if (!report_file_name_.isEmpty()) {
+        QFile file(report_file_name_);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            file.write(statistics_.toJson());
+        } else {
+            qWarning() << "Unable to open file:" << report_file_name_;
+        }
+    }
+
+    emit statisticsChanged(statistics_);
 }
 
 void CollectionExportWorker::onMyDecomposeDataReceived([[maybe_unused]] int scene,
                                                        const QByteArray &json)
 {
     // file is closed
-    if (!file_->isOpen()) {
+    if (!exporting_) {
         return;
     }
 
+    QElapsedTimer timer;
+    timer.start();
     bool ok;
-    const MyDecomposeData d = MyDecomposeData::fromJson(json, &ok);
+    int code;
+    const MyDecomposeData d = MyDecomposeData::fromJson(json, &ok, &code);
+    RequestMetrics::instance().recordParse(RequestMetrics::kMyDecompose, timer.nsecsElapsed(),
+                                           code);
 
     if (!ok) {
+        closeFile();
+        emit errorOccurred(u"json 非法"_s);
         emit finished();
         return;
     }
 
-    if (!d.list.has_value()) {
+    // 没有任何收藏集时只有表头
+    if (!d.list.has_value() || d.list->empty()) {
+        closeFile();
+        finishStatistics();
         emit finished();
         return;
     }
 
     my_decompose_data_.reset(new MyDecomposeData(d));
-    timer_id_ = static_cast<Qt::TimerId>(startTimer(std::chrono::milliseconds(300)));
+    timer_id_ = static_cast<Qt::TimerId>(
+            startTimer(std::chrono::milliseconds(manager_->isOffline() ? 0 : request_interval_)));
     if (timer_id_ == Qt::TimerId::Invalid) {
         qWarning() << "Failed to start timer";
+        closeFile();
+        emit errorOccurred(u"无法启动定时器"_s);
         emit finished();
         return;
     }
@@ -91,86 +417,110 @@ void CollectionExportWorker::onMyDecomposeDataReceived([[maybe_unused]] int scen
     current_ = 0;
     // NOLINTNEXTLINE(cppcoreguidelines-narrowing-conversions)
     total_ = my_decompose_data_->list->size();
+    statistics_.total = total_;
 }
 
-void CollectionExportWorker::onAssetBagDataReceived([[maybe_unused]] int act_id,
-                                                    const QString &act_name,
-                                                    [[maybe_unused]] int lottery_id,
-                                                    [[maybe_unused]] int ruid,
+void CollectionExportWorker::onAssetBagDataReceived(int act_id, const QString &act_name,
+                                                    int lottery_id, [[maybe_unused]] int ruid,
                                                     const QByteArray &json)
 {
+    QElapsedTimer timer;
+    timer.start();
     bool ok;
-    const AssetBagData d = AssetBagData::fromJson(json, &ok);
+    int code;
+    const CardStore d = CardStore::fromJson(json, &ok, &code);
+    const qint64 parse = timer.nsecsElapsed();
+    RequestMetrics::instance().recordParse(RequestMetrics::kAssetBag, parse, code);
 
+    if (code == kThrottledCode) {
+        onThrottled(act_id);
+        return;
+    }
+    in_flight_.remove(act_id);
     if (!ok) {
-        if (file_->isOpen()) {
-            file_->close();
+        if (exporting_) {
+            stopAction();
+            emit errorOccurred(u"json 非法"_s);
+            emit finished();
         }
-        emit finished();
         return;
     }
 
-    if (!file_->isOpen()) {
+    if (!exporting_) {
         return;
     }
 
-    {
-        QTextStream out(file_);
-
-        if (d.item_list.has_value()) {
-            for (auto &&item : d.item_list.value()) {
-                if (!item.card_item.has_value()) {
-                    continue;
-                }
-
-                if (item.card_item->card_id_list.has_value()) {
-                    for (auto &&card : item.card_item->card_id_list.value()) {
-                        QStringList string_list;
-                        string_list << act_name << item.card_item->card_name << item.scarcity()
-                                    << card.card_no
-                                    << (item.card_item->is_limited_card != 0 ? u"限量"_s : u"/"_s);
-                        out << string_list.join(',') << '\n';
-                    }
-                }
-            }
-        }
-
-        if (d.collect_list.has_value()) {
-            for (auto &&collect : d.collect_list.value()) {
-                if (!collect.card_item.has_value()
-                    || !collect.card_item->card_type_info.has_value()) {
-                    continue;
-                }
-
-                if (collect.card_item->card_asset_info->card_item->card_id_list.has_value()) {
-                    for (auto &&card :
-                         collect.card_item->card_asset_info->card_item->card_id_list.value()) {
-                        QStringList string_list;
-                        string_list << act_name << collect.card_item->card_type_info->name
-                                    << u"典藏卡"_s << card.card_no << u"/"_s;
-                        out << string_list.join(',') << '\n';
-                    }
-                }
-            }
-        }
+    timer.restart();
+    const QByteArray rows = formatCsvRows(act_name, d, account_name_);
+    const qint64 format = timer.nsecsElapsed();
+    emit writeRequested(rows);
+    recordCollection(act_id, act_name, parse, format, rows);
+    if (owns_file_ && !archive_file_name_.isEmpty()) {
+        emit archiveWriteRequested(
+                ResponseArchiveRecord{ QDateTime::currentDateTime(), act_id, act_name, lottery_id,
+                                       json }
+                        .toJsonLine());
     }
 
     emit progressChanged(++current_, total_);
     if (current_ == total_) {
         // close file when finished
-        if (file_->isOpen()) {
-            file_->close();
-        }
+        closeFile();
+        finishStatistics();
+        emit finished();
+    }
+}
+
+void CollectionExportWorker::onThrottled(int act_id)
+{
+    const auto iter = in_flight_.constFind(act_id);
+    if (!exporting_ || !my_decompose_data_ || iter == in_flight_.cend()) {
+        return;
+    }
+
+    ++statistics_.throttled;
+    if (++throttle_count_ > kMaxThrottleRetries) {
+        stopAction();
+        emit errorOccurred(u"请求被服务器限流 (412)"_s);
+        emit finished();
+        return;
+    }
+    my_decompose_data_->list->append(MyDecomposeData::ListItem{ iter.value(), act_id, 0 });
+    in_flight_.erase(iter);
+
+    // 暂停期间发出的请求同样可能被限流，只需要放回队列
+    if (throttle_timer_id_ != Qt::TimerId::Invalid) {
+        return;
+    }
+    if (timer_id_ != Qt::TimerId::Invalid) {
+        killTimer(timer_id_);
+        timer_id_ = Qt::TimerId::Invalid;
+    }
+    const int backoff = std::min(kThrottleBackoff << (throttle_count_ - 1), kMaxThrottleBackoff);
+    qWarning() << "Throttled, retrying in" << backoff << "ms, act_id:" << act_id;
+    throttle_started_ = export_timer_.nsecsElapsed();
+    throttle_timer_id_ = static_cast<Qt::TimerId>(startTimer(std::chrono::milliseconds(backoff)));
+    if (throttle_timer_id_ == Qt::TimerId::Invalid) {
+        qWarning() << "Failed to start timer";
+        stopAction();
+        emit errorOccurred(u"无法启动定时器"_s);
         emit finished();
     }
 }
 
 void CollectionExportWorker::timerEvent(QTimerEvent *event)
 {
-    if (timer_id_ == event->id()) {
+    if (throttle_timer_id_ == event->id()) {
+        killTimer(throttle_timer_id_);
+        throttle_timer_id_ = Qt::TimerId::Invalid;
+        statistics_.throttle_wait += export_timer_.nsecsElapsed() - throttle_started_;
+        timer_id_ = static_cast<Qt::TimerId>(
+                startTimer(std::chrono::milliseconds(request_interval_)));
+    } else if (timer_id_ == event->id()) {
         if (!my_decompose_data_->list->empty()) {
-            manager_->getAssetBag(my_decompose_data_->list->back().act_id,
-                                  my_decompose_data_->list->back().act_name);
+            const auto &item = my_decompose_data_->list->back();
+            in_flight_.insert(item.act_id, item.act_name);
+            manager_->getAssetBag(item.act_id, item.act_name);
             my_decompose_data_->list->pop_back();
         }
         if (my_decompose_data_->list->empty()) {
@@ -179,4 +529,4 @@ void CollectionExportWorker::timerEvent(QTimerEvent *event)
         }
     }
     QObject::timerEvent(event);
-}
\ No newline at end of file
+}
@@ -2,15 +2,19 @@
 #define COLLECTION_EXPORT_WORKER_HH
 
 #include <QObject>
+#include <QByteArray>
 #include <QString>
 #include <QScopedPointer>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QHash>
 
-QT_BEGIN_NAMESPACE
-class QFile;
-QT_END_NAMESPACE
+#include "export_statistics.hh"
 
 struct MyDecomposeData;
+class CardStore;
 class BilibiliRequestManager;
+class CompressedFileWriter;
 
 class CollectionExportWorker : public QObject
 {
@@ -18,9 +22,32 @@ class CollectionExportWorker : public QObject
 
 public:
     explicit CollectionExportWorker(QObject *parent = nullptr);
+    ~CollectionExportWorker() override;
+
+    /// 多账号合并导出时第一列为账号
+    [[nodiscard]] static QByteArray csvHeader(bool with_account = false);
+    [[nodiscard]] static QByteArray formatCsvRows(const QString &act_name, const CardStore &store,
+                                                  const QString &account_name = QString());
 
 public slots:
+    /// 文件名以 .gz/.br 结尾时直接写入压缩后的 CSV
     void exportToCsvFile(const QString &file_name, const QString &cookie);
+    /// 不访问网络，从原始响应存档重新生成 CSV
+    void exportArchiveToCsvFile(const QString &archive_file_name, const QString &file_name);
+    /// 导出时将每个原始响应追加到存档，为空则不存档
+    void setArchiveFileName(const QString &archive_file_name);
+    /// 导出结束时将统计报告以 JSON 格式写入该文件，为空（默认）则只输出到日志
+    void setReportFileName(const QString &report_file_name);
+    /// 不写文件，只通过 writeRequested() 输出数据行（不含表头），由调用方连接到共享的文件
+    void exportToSink(const QString &cookie);
+    /// 不为空时每行前加上账号一列
+    void setAccountName(const QString &account_name);
+    /// 请求 asset_bag 的间隔，即每个账号单独的频率限制
+    void setRequestInterval(int msec);
+    /// 离线时从缓存导出，不访问网络，也不需要请求间隔
+    void setOffline(bool offline);
+    /// 与界面共用的响应缓存目录
+    void setCacheDirectory(const QString &dir);
     void stopAction();
 
 private slots:
@@ -31,17 +58,50 @@ private slots:
 signals:
     void finished();
     void progressChanged(int current, int total);
+    /// 导出失败时在 finished() 之前发出
+    void errorOccurred(const QString &message);
+    /// 每完成一个收藏集发出一次，结束时（finished() 之前）再发出一次最终结果
+    void statisticsChanged(const ExportStatistics &statistics);
+
+signals:
+    void writeRequested(const QByteArray &data);
+    void archiveWriteRequested(const QByteArray &data);
 
 protected:
     void timerEvent(QTimerEvent *event) override;
 
 private:
+    bool openFile(const QString &file_name);
+    void closeFile();
+    void resetStatistics();
+    void recordCollection(int act_id, const QString &act_name, qint64 parse, qint64 format,
+                          const QByteArray &rows);
+    void finishStatistics();
+    /// 服务器返回 412 时把收藏集放回队列，暂停请求一段时间后重试
+    void onThrottled(int act_id);
+
     BilibiliRequestManager *manager_;
-    QFile *file_;
+    QThread writer_thread_; ///< 第一次打开文件时启动
+    CompressedFileWriter *writer_; ///< 位于 writer_thread_，压缩不会拖慢请求
+    CompressedFileWriter *archive_writer_; ///< 同样位于 writer_thread_
+    QString archive_file_name_;
+    QString account_name_;
+    int request_interval_;
+    bool exporting_;
+    bool owns_file_; ///< exportToSink() 时为 false
     Qt::TimerId timer_id_;
+    Qt::TimerId throttle_timer_id_; ///< 限流后暂停请求，结束时重新启动 timer_id_
+    int throttle_count_;            ///< 连续被限流的次数，成功后清零
+    qint64 throttle_started_;
     int current_;
     int total_;
     QScopedPointer<MyDecomposeData> my_decompose_data_;
+    QHash<int, QString> in_flight_; ///< 已经发出请求的收藏集 {act_id, act_name}，限流时放回队列
+    ExportStatistics statistics_;
+    ExportStatistics::CollectionItem last_reply_; ///< 最近一次 asset_bag 响应的传输数据
+    QElapsedTimer export_timer_;
+    qint64 last_completion_;
+    QString report_file_name_; ///< 结束时写入的统计报告，默认为空，不写
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,16 +1,20 @@
 #include <algorithm>
-#include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <iterator>
 
 #include <brotli/decode.h>
+#include <brotli/encode.h>
 #include <zlib.h>
 
 #include "compress_helper.hh"
+#include "trace.hh"
+#include "allocation_accounting.hh"
 
-QByteArray uncompressGzip(const QByteArray &src, bool *ok)
+QByteArray uncompressGzip(const QByteArray &src, bool *ok, qsizetype max_size)
 {
+    TRACE_SCOPE("decode", "uncompressGzip");
+    ALLOCATION_SCOPE(Decompression);
     z_stream strm;
 
     strm.zalloc = Z_NULL;
@@ -43,12 +47,13 @@ QByteArray uncompressGzip(const QByteArray &src, bool *ok)
         strm.avail_in = block_length;
         strm.next_in = in;
 
-        do {
+        for (;;) {
             strm.avail_out = CHUNK;
             strm.next_out = out;
             const int ret = inflate(&strm, Z_NO_FLUSH);
-            assert(ret != Z_STREAM_ERROR);
             switch (ret) {
+            case Z_STREAM_ERROR:
+                [[fallthrough]];
             case Z_NEED_DICT:
                 [[fallthrough]];
             case Z_DATA_ERROR:
@@ -61,8 +66,25 @@ QByteArray uncompressGzip(const QByteArray &src, bool *ok)
             default:
                 break;
             }
+            if (static_cast<qsizetype>(CHUNK - strm.avail_out) > max_size - std::size(res)) {
+                inflateEnd(&strm);
+                if (ok)
+                    *ok = false;
+                return {};
+            }
             res.append(reinterpret_cast<char *>(out), CHUNK - strm.avail_out);
-        } while (strm.avail_out == 0);
+            // RFC 1952 允许多个 gzip 成员首尾相接，例如追加写入的存档文件
+            if (ret == Z_STREAM_END) {
+                if (strm.avail_in == 0) {
+                    break;
+                }
+                inflateReset(&strm);
+                continue;
+            }
+            if (strm.avail_out != 0) {
+                break;
+            }
+        }
     }
 
     inflateEnd(&strm);
@@ -72,9 +94,85 @@ QByteArray uncompressGzip(const QByteArray &src, bool *ok)
     return res;
 }
 
-QByteArray uncompressBrotli(const QByteArray &src, bool *ok)
+QByteArray uncompressGzipPrefix(const QByteArray &src, bool *complete, qsizetype max_size)
+{
+    TRACE_SCOPE("decode", "uncompressGzipPrefix");
+    ALLOCATION_SCOPE(Decompression);
+    if (complete)
+        *complete = false;
+
+    z_stream strm;
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+
+    if (inflateInit2(&strm, MAX_WBITS | 16) != Z_OK) {
+        return {};
+    }
+
+    enum { CHUNK = 16384 };
+    Bytef out[CHUNK];
+
+    const auto *next_in = reinterpret_cast<const Bytef *>(src.constData());
+    qsizetype remaining = std::size(src);
+
+    QByteArray res;
+    bool error = false;
+    bool member_end = true; // 空文件也是完整的
+
+    for (;;) {
+        if (strm.avail_in == 0 && remaining != 0) {
+            const qsizetype block_length = std::min<qsizetype>(remaining, CHUNK);
+            strm.next_in = const_cast<Bytef *>(next_in);
+            strm.avail_in = static_cast<uInt>(block_length);
+            next_in += block_length;
+            remaining -= block_length;
+        }
+        strm.avail_out = CHUNK;
+        strm.next_out = out;
+        const int ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret == Z_BUF_ERROR) {
+            // 输入已经用完
+            break;
+        }
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            error = true;
+            break;
+        }
+        if (static_cast<qsizetype>(CHUNK - strm.avail_out) > max_size - std::size(res)) {
+            error = true;
+            break;
+        }
+        res.append(reinterpret_cast<char *>(out), CHUNK - strm.avail_out);
+        member_end = ret == Z_STREAM_END;
+        if (member_end) {
+            inflateReset(&strm);
+        }
+        if (strm.avail_in == 0 && remaining == 0 && strm.avail_out != 0) {
+            break;
+        }
+    }
+
+    inflateEnd(&strm);
+
+    if (complete)
+        *complete = !error && member_end;
+    return res;
+}
+
+QByteArray uncompressBrotli(const QByteArray &src, bool *ok, qsizetype max_size)
 {
+    TRACE_SCOPE("decode", "uncompressBrotli");
+    ALLOCATION_SCOPE(Decompression);
     BrotliDecoderState *state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+    if (state == nullptr) {
+        if (ok)
+            *ok = false;
+        return {};
+    }
 
     enum { CHUNK = 16384 };
     std::uint8_t out[CHUNK];
@@ -90,23 +188,19 @@ QByteArray uncompressBrotli(const QByteArray &src, bool *ok)
 
         const BrotliDecoderResult result = BrotliDecoderDecompressStream(
                 state, &available_in, &next_in, &available_out, &next_out, nullptr);
-        if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT
-            || result == BROTLI_DECODER_RESULT_SUCCESS) {
-            res.append(reinterpret_cast<char *>(out),
-                       static_cast<qsizetype>(CHUNK - available_out));
-            if (result == BROTLI_DECODER_RESULT_SUCCESS) {
-                break;
-            }
-        }
-
+        const auto length = static_cast<qsizetype>(CHUNK - available_out);
         if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT
-            || result == BROTLI_DECODER_RESULT_ERROR) {
+            || result == BROTLI_DECODER_RESULT_ERROR || length > max_size - std::size(res)) {
             BrotliDecoderDestroyInstance(state);
             if (ok) {
                 *ok = false;
             }
             return {};
         }
+        res.append(reinterpret_cast<char *>(out), length);
+        if (result == BROTLI_DECODER_RESULT_SUCCESS) {
+            break;
+        }
     }
 
     BrotliDecoderDestroyInstance(state);
@@ -116,8 +210,10 @@ QByteArray uncompressBrotli(const QByteArray &src, bool *ok)
     return res;
 }
 
-QByteArray uncompressDeflate(const QByteArray &src, bool *ok)
+QByteArray uncompressDeflate(const QByteArray &src, bool *ok, qsizetype max_size)
 {
+    TRACE_SCOPE("decode", "uncompressDeflate");
+    ALLOCATION_SCOPE(Decompression);
     z_stream strm;
 
     strm.zalloc = Z_NULL;
@@ -155,8 +251,9 @@ QByteArray uncompressDeflate(const QByteArray &src, bool *ok)
             strm.avail_out = CHUNK;
             strm.next_out = out;
             const int ret = inflate(&strm, Z_NO_FLUSH);
-            assert(ret != Z_STREAM_ERROR);
             switch (ret) {
+            case Z_STREAM_ERROR:
+                [[fallthrough]];
             case Z_NEED_DICT:
                 [[fallthrough]];
             case Z_DATA_ERROR:
@@ -169,6 +266,12 @@ QByteArray uncompressDeflate(const QByteArray &src, bool *ok)
             default:
                 break;
             }
+            if (static_cast<qsizetype>(CHUNK - strm.avail_out) > max_size - std::size(res)) {
+                inflateEnd(&strm);
+                if (ok)
+                    *ok = false;
+                return {};
+            }
             res.append(reinterpret_cast<char *>(out), CHUNK - strm.avail_out);
         } while (strm.avail_out == 0);
     }
@@ -180,8 +283,10 @@ QByteArray uncompressDeflate(const QByteArray &src, bool *ok)
     return res;
 }
 
-QByteArray uncompressZlib(const QByteArray &src, bool *ok)
+QByteArray uncompressZlib(const QByteArray &src, bool *ok, qsizetype max_size)
 {
+    TRACE_SCOPE("decode", "uncompressZlib");
+    ALLOCATION_SCOPE(Decompression);
     z_stream strm;
 
     strm.zalloc = Z_NULL;
@@ -215,8 +320,9 @@ QByteArray uncompressZlib(const QByteArray &src, bool *ok)
             strm.avail_out = CHUNK;
             strm.next_out = out;
             const int ret = inflate(&strm, Z_NO_FLUSH);
-            assert(ret != Z_STREAM_ERROR);
             switch (ret) {
+            case Z_STREAM_ERROR:
+                [[fallthrough]];
             case Z_NEED_DICT:
                 [[fallthrough]];
             case Z_DATA_ERROR:
@@ -229,6 +335,12 @@ QByteArray uncompressZlib(const QByteArray &src, bool *ok)
             default:
                 break;
             }
+            if (static_cast<qsizetype>(CHUNK - strm.avail_out) > max_size - std::size(res)) {
+                inflateEnd(&strm);
+                if (ok)
+                    *ok = false;
+                return {};
+            }
             res.append(reinterpret_cast<char *>(out), CHUNK - strm.avail_out);
         } while (strm.avail_out == 0);
     }
@@ -238,4 +350,198 @@ QByteArray uncompressZlib(const QByteArray &src, bool *ok)
     if (ok)
         *ok = true;
     return res;
-}
\ No newline at end of file
+}
+
+struct StreamCompressor::Private
+{
+    Encoding encoding;
+    bool valid;
+    bool finished;
+    z_stream strm;
+    BrotliEncoderState *state;
+
+    bool process(const std::uint8_t *data, std::size_t size, bool finish, QByteArray &res);
+};
+
+StreamCompressor::StreamCompressor(Encoding encoding, int level) : d_(new Private)
+{
+    d_->encoding = encoding;
+    d_->valid = false;
+    d_->finished = false;
+    d_->state = nullptr;
+
+    if (encoding == Encoding::Brotli) {
+        d_->state = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if (d_->state == nullptr) {
+            return;
+        }
+        // 默认的 11 对于导出这种一边生成一边写入的场景太慢了
+        const std::uint32_t quality = level < 0 ? 5 : static_cast<std::uint32_t>(level);
+        BrotliEncoderSetParameter(d_->state, BROTLI_PARAM_QUALITY, quality);
+        BrotliEncoderSetParameter(d_->state, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+        d_->valid = true;
+        return;
+    }
+
+    d_->strm.zalloc = Z_NULL;
+    d_->strm.zfree = Z_NULL;
+    d_->strm.opaque = Z_NULL;
+    d_->strm.avail_in = 0;
+    d_->strm.next_in = Z_NULL;
+
+    /// \see https://www.zlib.net/manual.html
+    /// 与 inflateInit2() 相同，+16 为 gzip，负数为 raw deflate
+    int window_bits = MAX_WBITS;
+    switch (encoding) {
+    case Encoding::Gzip:
+        window_bits = MAX_WBITS | 16;
+        break;
+    case Encoding::Deflate:
+        window_bits = -MAX_WBITS;
+        break;
+    default:
+        break;
+    }
+
+    d_->valid = deflateInit2(&d_->strm, level < 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED,
+                             window_bits, 8, Z_DEFAULT_STRATEGY)
+            == Z_OK;
+}
+
+StreamCompressor::~StreamCompressor()
+{
+    if (d_->state != nullptr) {
+        BrotliEncoderDestroyInstance(d_->state);
+    } else if (d_->valid) {
+        deflateEnd(&d_->strm);
+    }
+}
+
+StreamCompressor::Encoding StreamCompressor::encoding() const
+{
+    return d_->encoding;
+}
+
+bool StreamCompressor::isValid() const
+{
+    return d_->valid;
+}
+
+bool StreamCompressor::isFinished() const
+{
+    return d_->finished;
+}
+
+bool StreamCompressor::Private::process(const std::uint8_t *data, std::size_t size, bool finish,
+                                        QByteArray &res)
+{
+    enum { CHUNK = 16384 };
+    std::uint8_t out[CHUNK];
+
+    if (encoding == Encoding::Brotli) {
+        const BrotliEncoderOperation op =
+                finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+        std::size_t available_in = size;
+        const std::uint8_t *next_in = data;
+
+        for (;;) {
+            std::size_t available_out = CHUNK;
+            std::uint8_t *next_out = out;
+            if (!BrotliEncoderCompressStream(state, op, &available_in, &next_in, &available_out,
+                                             &next_out, nullptr)) {
+                return false;
+            }
+            res.append(reinterpret_cast<char *>(out),
+                       static_cast<qsizetype>(CHUNK - available_out));
+            if (finish ? BrotliEncoderIsFinished(state) != 0
+                       : available_in == 0 && BrotliEncoderHasMoreOutput(state) == 0) {
+                return true;
+            }
+        }
+    }
+
+    // zlib 的 avail_in 是 uInt，这里按块喂入
+    do {
+        const std::size_t block_length = std::min<std::size_t>(size, 1U << 30);
+        const bool last_block = block_length == size;
+        const int flush = finish && last_block ? Z_FINISH : Z_NO_FLUSH;
+        strm.avail_in = static_cast<uInt>(block_length);
+        strm.next_in = const_cast<Bytef *>(data);
+
+        int ret;
+        do {
+            strm.avail_out = CHUNK;
+            strm.next_out = out;
+            ret = deflate(&strm, flush);
+            if (ret == Z_STREAM_ERROR) {
+                return false;
+            }
+            res.append(reinterpret_cast<char *>(out), CHUNK - strm.avail_out);
+        } while (strm.avail_out == 0);
+
+        if (flush == Z_FINISH && ret != Z_STREAM_END) {
+            return false;
+        }
+
+        data += block_length;
+        size -= block_length;
+    } while (size != 0);
+
+    return true;
+}
+
+QByteArray StreamCompressor::compress(const QByteArray &src, bool *ok)
+{
+    QByteArray res;
+    const bool success = d_->valid && !d_->finished
+            && d_->process(reinterpret_cast<const std::uint8_t *>(src.constData()),
+                           std::size(src), false, res);
+    if (ok)
+        *ok = success;
+    return success ? res : QByteArray();
+}
+
+QByteArray StreamCompressor::finish(bool *ok)
+{
+    QByteArray res;
+    const bool success = d_->valid && !d_->finished && d_->process(nullptr, 0, true, res);
+    d_->finished = true;
+    if (ok)
+        *ok = success;
+    return success ? res : QByteArray();
+}
+
+static QByteArray compressOneShot(StreamCompressor::Encoding encoding, const QByteArray &src,
+                                  bool *ok)
+{
+    TRACE_SCOPE("encode", "compress");
+    StreamCompressor compressor(encoding);
+    bool success = false;
+    QByteArray res = compressor.compress(src, &success);
+    if (success) {
+        res.append(compressor.finish(&success));
+    }
+    if (ok)
+        *ok = success;
+    return success ? res : QByteArray();
+}
+
+QByteArray compressGzip(const QByteArray &src, bool *ok)
+{
+    return compressOneShot(StreamCompressor::Encoding::Gzip, src, ok);
+}
+
+QByteArray compressBrotli(const QByteArray &src, bool *ok)
+{
+    return compressOneShot(StreamCompressor::Encoding::Brotli, src, ok);
+}
+
+QByteArray compressDeflate(const QByteArray &src, bool *ok)
+{
+    return compressOneShot(StreamCompressor::Encoding::Deflate, src, ok);
+}
+
+QByteArray compressZlib(const QByteArray &src, bool *ok)
+{
+    return compressOneShot(StreamCompressor::Encoding::Zlib, src, ok);
+}
@@ -3,22 +3,75 @@
 
 #include <QAnyStringView>
 #include <QByteArray>
+#include <QScopedPointer>
 
-QByteArray uncompressGzip(const QByteArray &src, bool *ok = nullptr);
-QByteArray uncompressBrotli(const QByteArray &src, bool *ok = nullptr);
-QByteArray uncompressDeflate(const QByteArray &src, bool *ok = nullptr);
-QByteArray uncompressZlib(const QByteArray &src, bool *ok = nullptr);
-inline QByteArray uncompress(const QByteArray &src, QAnyStringView encoding, bool *ok = nullptr);
+/// 解压后的默认上限，最大的收藏集也只有几 MB，超过时视为解压炸弹而失败
+inline constexpr qsizetype kMaxUncompressedSize = qsizetype{ 64 } << 20;
+
+QByteArray uncompressGzip(const QByteArray &src, bool *ok = nullptr,
+                          qsizetype max_size = kMaxUncompressedSize);
+QByteArray uncompressBrotli(const QByteArray &src, bool *ok = nullptr,
+                            qsizetype max_size = kMaxUncompressedSize);
+QByteArray uncompressDeflate(const QByteArray &src, bool *ok = nullptr,
+                             qsizetype max_size = kMaxUncompressedSize);
+QByteArray uncompressZlib(const QByteArray &src, bool *ok = nullptr,
+                          qsizetype max_size = kMaxUncompressedSize);
+inline QByteArray uncompress(const QByteArray &src, QAnyStringView encoding, bool *ok = nullptr,
+                             qsizetype max_size = kMaxUncompressedSize);
+/// \brief 解压首尾相接的多个 gzip 成员，遇到损坏或不完整的数据时停止，返回之前解压出的内容
+/// \param complete 非空时设置是否完整解压了所有数据
+/// \param max_size 解压后超过该大小时同样停止，complete 为 false
+QByteArray uncompressGzipPrefix(const QByteArray &src, bool *complete = nullptr,
+                                qsizetype max_size = kMaxUncompressedSize);
+
+/// \brief 流式压缩，可以多次调用 compress() 追加数据，最后调用 finish() 得到结尾
+class StreamCompressor
+{
+public:
+    enum class Encoding { Gzip, Brotli, Deflate, Zlib };
+
+    /// \param level 压缩等级，-1 为默认值（zlib 为 6，Brotli 为 5）
+    explicit StreamCompressor(Encoding encoding, int level = -1);
+    ~StreamCompressor();
+    Q_DISABLE_COPY_MOVE(StreamCompressor)
+
+    [[nodiscard]] Encoding encoding() const;
+    [[nodiscard]] bool isValid() const;
+    [[nodiscard]] bool isFinished() const;
+
+    QByteArray compress(const QByteArray &src, bool *ok = nullptr);
+    QByteArray finish(bool *ok = nullptr);
+
+private:
+    struct Private;
+    QScopedPointer<Private> d_;
+};
+
+QByteArray compressGzip(const QByteArray &src, bool *ok = nullptr);
+QByteArray compressBrotli(const QByteArray &src, bool *ok = nullptr);
+QByteArray compressDeflate(const QByteArray &src, bool *ok = nullptr);
+QByteArray compressZlib(const QByteArray &src, bool *ok = nullptr);
+inline QByteArray compress(const QByteArray &src, QAnyStringView encoding, bool *ok = nullptr);
 
 // clang-format off
-inline QByteArray uncompress(const QByteArray &src, QAnyStringView encoding, bool *ok)
+inline QByteArray uncompress(const QByteArray &src, QAnyStringView encoding, bool *ok,
+                             qsizetype max_size)
+{
+    if (encoding == "gzip") return uncompressGzip(src, ok, max_size);
+    if (encoding == "br") return uncompressBrotli(src, ok, max_size);
+    if (encoding == "deflate") return uncompressDeflate(src, ok, max_size);
+    if (ok) *ok = false;
+    return {};
+}
+
+inline QByteArray compress(const QByteArray &src, QAnyStringView encoding, bool *ok)
 {
-    if (encoding == "gzip") return uncompressGzip(src, ok);
-    if (encoding == "br") return uncompressBrotli(src, ok);
-    if (encoding == "deflate") return uncompressDeflate(src, ok);
+    if (encoding == "gzip") return compressGzip(src, ok);
+    if (encoding == "br") return compressBrotli(src, ok);
+    if (encoding == "deflate") return compressDeflate(src, ok);
     if (ok) *ok = false;
     return {};
 }
 // clang-format on
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,120 @@
+#include <QFile>
+#include <QtLogging>
+#include <QDebug>
+
+#include "compressed_file_writer.hh"
+#include "allocation_accounting.hh"
+
+using namespace Qt::Literals;
+
+CompressedFileWriter::CompressedFileWriter(QObject *parent)
+    : QObject(parent), file_(new QFile(this))
+{
+}
+
+CompressedFileWriter::~CompressedFileWriter()
+{
+    close();
+}
+
+std::optional<StreamCompressor::Encoding>
+CompressedFileWriter::encodingForFileName(const QString &file_name)
+{
+    if (file_name.endsWith(u".gz"_s, Qt::CaseInsensitive)) {
+        return StreamCompressor::Encoding::Gzip;
+    }
+    if (file_name.endsWith(u".br"_s, Qt::CaseInsensitive)) {
+        return StreamCompressor::Encoding::Brotli;
+    }
+    return std::nullopt;
+}
+
+bool CompressedFileWriter::isOpen() const
+{
+    return file_->isOpen();
+}
+
+bool CompressedFileWriter::open(const QString &file_name, bool append)
+{
+    ALLOCATION_SCOPE(Export); // 压缩器的内部状态
+    close();
+
+    const auto encoding = encodingForFileName(file_name);
+    QIODevice::OpenMode mode = QIODevice::WriteOnly;
+    if (append) {
+        mode |= QIODevice::Append;
+    }
+    if (append && encoding == StreamCompressor::Encoding::Brotli) {
+        qWarning() << "Unable to append to Brotli file:" << file_name;
+        emit errorOccurred(u"无法追加写入 Brotli 文件: %1"_s.arg(file_name));
+        return false;
+    }
+    if (encoding.has_value()) {
+        compressor_.reset(new StreamCompressor(encoding.value()));
+        if (!compressor_->isValid()) {
+            compressor_.reset();
+            emit errorOccurred(u"无法初始化压缩: %1"_s.arg(file_name));
+            return false;
+        }
+    } else {
+        // 未压缩时与之前一样按文本写入
+        mode |= QIODevice::Text;
+    }
+
+    file_->setFileName(file_name);
+    if (!file_->open(mode)) {
+        qWarning() << "Unable to open file:" << file_name;
+        compressor_.reset();
+        emit errorOccurred(u"无法打开文件: %1"_s.arg(file_name));
+        return false;
+    }
+    return true;
+}
+
+void CompressedFileWriter::write(const QByteArray &data)
+{
+    ALLOCATION_SCOPE(Export);
+    if (!file_->isOpen()) {
+        return;
+    }
+
+    if (compressor_) {
+#ifdef Q_OS_WIN
+        // 与未压缩时 QIODevice::Text 的换行一致
+        QByteArray text = data;
+        text.replace('\n', "\r\n");
+#else
+        const QByteArray &text = data;
+#endif
+        bool ok;
+        const QByteArray compressed = compressor_->compress(text, &ok);
+        if (!ok) {
+            qWarning() << "Failed to compress data";
+            emit errorOccurred(u"压缩失败"_s);
+            return;
+        }
+        // 压缩器有内部缓冲，不一定每次都有输出
+        if (!compressed.isEmpty()) {
+            file_->write(compressed);
+        }
+    } else {
+        file_->write(data);
+    }
+}
+
+void CompressedFileWriter::close()
+{
+    if (!file_->isOpen()) {
+        return;
+    }
+
+    if (compressor_) {
+        bool ok;
+        file_->write(compressor_->finish(&ok));
+        if (!ok) {
+            qWarning() << "Failed to finish compression";
+        }
+        compressor_.reset();
+    }
+    file_->close();
+}
@@ -0,0 +1,48 @@
+#ifndef COMPRESSED_FILE_WRITER_HH
+#define COMPRESSED_FILE_WRITER_HH
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QScopedPointer>
+
+#include <optional>
+
+#include "compress_helper.hh"
+
+QT_BEGIN_NAMESPACE
+class QFile;
+QT_END_NAMESPACE
+
+/// \brief 写文件，按后缀名（.gz/.br）选择压缩方式，通常移动到单独的线程中使用
+///
+/// 写入的是文本，Windows 上无论是否压缩换行都为 \r\n
+class CompressedFileWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CompressedFileWriter(QObject *parent = nullptr);
+    ~CompressedFileWriter() override;
+
+    [[nodiscard]] static std::optional<StreamCompressor::Encoding>
+    encodingForFileName(const QString &file_name);
+
+    [[nodiscard]] bool isOpen() const;
+
+public slots:
+    /// 追加写入压缩文件时会在末尾新增一个压缩流，gzip 的多个成员可以直接连续解压，
+    /// Brotli 不支持这样的拼接，追加写入 .br 文件会失败
+    bool open(const QString &file_name, bool append);
+    void write(const QByteArray &data);
+    void close();
+
+signals:
+    void errorOccurred(const QString &message);
+
+private:
+    QFile *file_;
+    QScopedPointer<StreamCompressor> compressor_;
+};
+
+#endif
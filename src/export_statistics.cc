@@ -0,0 +1,88 @@
+#include <nlohmann/json.hpp>
+
+#include "export_statistics.hh"
+
+using namespace Qt::Literals;
+
+double ExportStatistics::requestsPerSecond() const
+{
+    if (elapsed <= 0) {
+        return 0.0;
+    }
+    return static_cast<double>(requests) * 1e9 / static_cast<double>(elapsed);
+}
+
+qint64 ExportStatistics::eta() const
+{
+    if (average_interval <= 0.0 || total <= 0) {
+        return -1;
+    }
+    return static_cast<qint64>(average_interval * (total - current));
+}
+
+QString ExportStatistics::bottleneck() const
+{
+    if (current == 0 && throttled == 0) {
+        return u"unknown"_s;
+    }
+    const qint64 cpu = decode + parse + format;
+    // 固定的请求间隔是我们自己选的，只有实际被服务器限流、等待重试的时间最多时才算
+    if (throttled > 0 && throttle_wait >= latency && throttle_wait >= cpu) {
+        return u"rate_limit"_s;
+    }
+    return latency >= cpu ? u"network"_s : u"cpu"_s;
+}
+
+QString ExportStatistics::summary() const
+{
+    const auto ms = [](qint64 ns) { return QString::number(static_cast<double>(ns) / 1e6, 'f', 1); };
+    const auto kib = [](qint64 bytes) {
+        return QString::number(static_cast<double>(bytes) / 1024.0, 'f', 1);
+    };
+    return u"%1/%2 个收藏集，用时 %3 秒，%4 请求/秒，传输 %5 KiB（解压后 %6 KiB），"
+           "网络 %7 ms，解压 %8 ms，解析 %9 ms，格式化 %10 ms，限流 %11 次（等待 %12 ms），"
+           "瓶颈: %13"_s
+            .arg(current)
+            .arg(total)
+            .arg(QString::number(static_cast<double>(elapsed) / 1e9, 'f', 1))
+            .arg(QString::number(requestsPerSecond(), 'f', 2))
+            .arg(kib(received_bytes), kib(decoded_bytes), ms(latency), ms(decode), ms(parse),
+                 ms(format), QString::number(throttled), ms(throttle_wait), bottleneck());
+}
+
+QByteArray ExportStatistics::toJson() const
+{
+    nlohmann::json j = {
+        { "current", current },
+        { "total", total },
+        { "request_interval_ms", request_interval },
+        { "elapsed_ns", elapsed },
+        { "requests", requests },
+        { "requests_per_second", requestsPerSecond() },
+        { "received_bytes", received_bytes },
+        { "decoded_bytes", decoded_bytes },
+        { "latency_ns", latency },
+        { "decode_ns", decode },
+        { "parse_ns", parse },
+        { "format_ns", format },
+        { "rows", rows },
+        { "throttled", throttled },
+        { "throttle_wait_ns", throttle_wait },
+        { "bottleneck", bottleneck().toStdString() },
+    };
+    auto &&items = j["collections"] = nlohmann::json::array();
+    for (auto &&item : collections) {
+        items.push_back({
+                { "act_id", item.act_id },
+                { "act_name", item.act_name.toStdString() },
+                { "received_bytes", item.received_bytes },
+                { "decoded_bytes", item.decoded_bytes },
+                { "latency_ns", item.latency },
+                { "decode_ns", item.decode },
+                { "parse_ns", item.parse },
+                { "format_ns", item.format },
+                { "rows", item.rows },
+        });
+    }
+    return QByteArray::fromStdString(j.dump(2));
+}
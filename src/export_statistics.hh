@@ -0,0 +1,55 @@
+#ifndef EXPORT_STATISTICS_HH
+#define EXPORT_STATISTICS_HH
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QMetaType>
+
+/// \brief 导出过程中的吞吐量与各阶段耗时，时间单位均为纳秒
+// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+struct ExportStatistics
+{
+    struct CollectionItem
+    {
+        int act_id;
+        QString act_name;
+        qint64 received_bytes; ///< 压缩后，即实际传输的大小
+        qint64 decoded_bytes;
+        qint64 latency;        ///< 发出请求到收到完整响应
+        qint64 decode;
+        qint64 parse;
+        qint64 format;
+        int rows;
+    };
+
+    int current;
+    int total;
+    int request_interval;  ///< 毫秒，请求间隔（频率限制）
+    qint64 elapsed;
+    qint64 requests;
+    qint64 received_bytes;
+    qint64 decoded_bytes;
+    qint64 latency;
+    qint64 decode;
+    qint64 parse;
+    qint64 format;
+    qint64 rows;
+    qint64 throttled;     ///< 被服务器限流（HTTP 412 或 code -412）后重试的请求数
+    qint64 throttle_wait; ///< 限流后暂停请求的总时间
+    double average_interval; ///< 相邻两个收藏集完成的间隔的指数移动平均
+    QList<CollectionItem> collections;
+
+    [[nodiscard]] double requestsPerSecond() const;
+    /// 剩余时间的估计，未知时为 -1
+    [[nodiscard]] qint64 eta() const;
+    /// network/rate_limit/cpu 之一，表示主要耗时在哪里；rate_limit 指服务器的限流，
+    /// 不包括我们自己的请求间隔
+    [[nodiscard]] QString bottleneck() const;
+    [[nodiscard]] QString summary() const;
+    [[nodiscard]] QByteArray toJson() const;
+};
+
+Q_DECLARE_METATYPE(ExportStatistics)
+
+#endif
@@ -0,0 +1,54 @@
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <unordered_set>
+
+#include "interned_string.hh"
+
+namespace {
+
+struct StringHash
+{
+    size_t operator()(const QString &s) const { return qHash(s); }
+};
+
+// unordered_set 的元素地址在 rehash 后保持不变，可以直接作为句柄
+struct StringPool
+{
+    QMutex mutex;
+    std::unordered_set<QString, StringHash> strings{ QString() };
+};
+
+StringPool &pool()
+{
+    static StringPool p;
+    return p;
+}
+
+} // namespace
+
+InternedString::InternedString()
+{
+    // 默认构造的句柄很多（如 QList::resize），空字符串不需要每次加锁查表
+    static const QString *const empty = []() {
+        StringPool &p = pool();
+        QMutexLocker locker(&p.mutex);
+        return &*p.strings.find(QString());
+    }();
+    str_ = empty;
+}
+
+InternedString::InternedString(const QString &s)
+{
+    StringPool &p = pool();
+    QMutexLocker locker(&p.mutex);
+    str_ = &*p.strings.insert(s).first;
+}
+
+qsizetype InternedString::poolSize()
+{
+    StringPool &p = pool();
+    QMutexLocker locker(&p.mutex);
+    // NOLINTNEXTLINE(cppcoreguidelines-narrowing-conversions)
+    return p.strings.size();
+}
@@ -0,0 +1,35 @@
+#ifndef INTERNED_STRING_HH
+#define INTERNED_STRING_HH
+
+#include <QString>
+#include <QStringView>
+#include <QHashFunctions>
+
+/// \brief 进程内唯一的字符串句柄
+///
+/// 相同内容的字符串在全局表中只存一份，句柄只是指向表中元素的指针，
+/// 比较相等只需比较指针。表中的字符串在进程结束前不会释放，只用于卡名、收藏集名这类
+/// 种类有限又反复出现的字符串，图片地址这类几乎不重复的字符串不要放入。可以在任意线程中构造。
+class InternedString
+{
+public:
+    InternedString();
+    explicit InternedString(const QString &s);
+    explicit InternedString(QStringView s) : InternedString(s.toString()) { }
+
+    /// 与全局表共享数据，复制不会再分配
+    [[nodiscard]] const QString &toString() const { return *str_; }
+    [[nodiscard]] bool isEmpty() const { return str_->isEmpty(); }
+
+    /// 全局表中的字符串个数
+    [[nodiscard]] static qsizetype poolSize();
+
+    friend bool operator==(InternedString lhs, InternedString rhs) { return lhs.str_ == rhs.str_; }
+    friend bool operator!=(InternedString lhs, InternedString rhs) { return lhs.str_ != rhs.str_; }
+    friend size_t qHash(InternedString key, size_t seed = 0) { return qHash(key.str_, seed); }
+
+private:
+    const QString *str_;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <QtAssert>
+
+#include <algorithm>
+#include <memory>
+
+#include "json_arena.hh"
+
+namespace {
+
+struct ArenaState
+{
+    std::pmr::memory_resource *current = nullptr;
+    std::unique_ptr<std::byte[]> buffer;
+    std::size_t capacity = 0;
+};
+
+thread_local ArenaState state;
+
+// 小于它的响应也按它分配，避免缓冲区反复增长
+constexpr std::size_t kMinimumCapacity = 64 * 1024;
+
+/// 单调分配区不需要清零的内存
+std::unique_ptr<std::byte[]> allocateBuffer(std::size_t capacity)
+{
+    return std::unique_ptr<std::byte[]>(new std::byte[capacity]);
+}
+
+} // namespace
+
+JsonArena::JsonArena(std::size_t size_hint)
+    : oversized_buffer_(),
+      resource_([this, size_hint]() -> std::pmr::monotonic_buffer_resource {
+          // DOM 通常是原文的数倍，缓冲区不够时从堆上继续分配
+          const std::size_t capacity = std::max(size_hint, kMinimumCapacity);
+          if (capacity > kMaximumRetainedCapacity) {
+              oversized_buffer_ = allocateBuffer(capacity);
+              return std::pmr::monotonic_buffer_resource(oversized_buffer_.get(), capacity,
+                                                         std::pmr::new_delete_resource());
+          }
+          if (state.capacity < capacity) {
+              // 先释放旧的，避免同时持有两块
+              state.buffer.reset();
+              state.buffer = allocateBuffer(capacity);
+              state.capacity = capacity;
+          }
+          return std::pmr::monotonic_buffer_resource(state.buffer.get(), state.capacity,
+                                                     std::pmr::new_delete_resource());
+      }())
+{
+    Q_ASSERT(state.current == nullptr);
+    state.current = &resource_;
+}
+
+JsonArena::~JsonArena()
+{
+    state.current = nullptr;
+}
+
+std::pmr::memory_resource *JsonArena::current()
+{
+    return state.current != nullptr ? state.current : std::pmr::new_delete_resource();
+}
@@ -0,0 +1,103 @@
+#ifndef JSON_ARENA_HH
+#define JSON_ARENA_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+#include <string>
+#include <memory_resource>
+
+#include <nlohmann/json.hpp>
+
+/// \brief 解析单个响应时使用的单调分配区
+///
+/// 在 JsonArena 的生存期内，当前线程上新建的 ArenaJson（节点、数组、对象与字符串）都从同一块内存中
+/// 顺序分配，释放是空操作，析构时整块归还。不超过 kMaximumRetainedCapacity 的缓冲区按线程复用，
+/// 稳定状态下解析一个响应不需要向堆申请内存。不能嵌套使用。
+/// 与 std::pmr 相同，从分配区分配的 ArenaJson 必须在 JsonArena 之前析构。
+class JsonArena
+{
+public:
+    /// 更大的缓冲区只在这次解析中使用，析构时释放
+    static constexpr std::size_t kMaximumRetainedCapacity = 4 * 1024 * 1024;
+
+    explicit JsonArena(std::size_t size_hint);
+    ~JsonArena();
+    JsonArena(const JsonArena &) = delete;
+    JsonArena &operator=(const JsonArena &) = delete;
+
+    /// 没有活动的分配区时为 std::pmr::new_delete_resource()
+    static std::pmr::memory_resource *current();
+
+private:
+    std::unique_ptr<std::byte[]> oversized_buffer_;
+    std::pmr::monotonic_buffer_resource resource_;
+};
+
+/// \brief 与 std::pmr::polymorphic_allocator 类似，保存构造时的 memory_resource
+///
+/// nlohmann::basic_json 会临时默认构造分配器来创建与销毁对象、数组和字符串本身，
+/// 因此每块内存前还记录了分配它的 memory_resource，释放时归还给它，而不是当前线程的分配区。
+template <typename Tp>
+class ArenaAllocator
+{
+public:
+    using value_type = Tp;
+
+    ArenaAllocator() noexcept : resource_(JsonArena::current()) { }
+    explicit ArenaAllocator(std::pmr::memory_resource *resource) noexcept : resource_(resource) { }
+    template <typename Up>
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    ArenaAllocator(const ArenaAllocator<Up> &other) noexcept : resource_(other.resource())
+    {
+    }
+
+    [[nodiscard]] std::pmr::memory_resource *resource() const noexcept { return resource_; }
+
+    Tp *allocate(std::size_t n)
+    {
+        void *p = resource_->allocate(n * sizeof(Tp) + sizeof(Header),
+                                      std::max(alignof(Tp), alignof(Header)));
+        Header *header = static_cast<Header *>(p);
+        header->resource = resource_;
+        return reinterpret_cast<Tp *>(header + 1);
+    }
+    void deallocate(Tp *p, std::size_t n) noexcept
+    {
+        Header *header = reinterpret_cast<Header *>(p) - 1;
+        header->resource->deallocate(header, n * sizeof(Tp) + sizeof(Header),
+                                     std::max(alignof(Tp), alignof(Header)));
+    }
+
+    /// 复制（包括复制到另一个线程）时使用复制所在线程的分配区
+    [[nodiscard]] ArenaAllocator select_on_container_copy_construction() const
+    {
+        return ArenaAllocator();
+    }
+
+    friend bool operator==(const ArenaAllocator &lhs, const ArenaAllocator &rhs)
+    {
+        return lhs.resource_ == rhs.resource_;
+    }
+    friend bool operator!=(const ArenaAllocator &lhs, const ArenaAllocator &rhs)
+    {
+        return lhs.resource_ != rhs.resource_;
+    }
+
+private:
+    struct alignas(std::max_align_t) Header
+    {
+        std::pmr::memory_resource *resource;
+    };
+
+    std::pmr::memory_resource *resource_;
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+using ArenaJson = nlohmann::basic_json<std::map, std::vector, ArenaString, bool, std::int64_t,
+                                       std::uint64_t, double, ArenaAllocator>;
+
+#endif
@@ -8,19 +8,29 @@
 
 #include <nlohmann/json.hpp>
 
-template <typename Tp>
-inline void from_json(const nlohmann::json &j, QList<Tp> &list);
+#include "interned_string.hh"
+
+// 对 json 的类型是模板，同一份 from_json 也可以用于 ArenaJson（见 json_arena.hh）
+template <typename BasicJsonType, typename Tp>
+inline void from_json(const BasicJsonType &j, QList<Tp> &list);
 // clang-format off
-inline void from_json(const nlohmann::json &j, QString &s)
-{ s = QString::fromStdString(j.get<std::string>()); }
-inline void from_json(const nlohmann::json &j, QUrl &u)
-{ u.setUrl(j.get<QString>()); }
-inline void from_json(const nlohmann::json &j, QDateTime &d)
-{ d = QDateTime::fromSecsSinceEpoch(j.get<qint64>()); }
+template <typename BasicJsonType>
+inline void from_json(const BasicJsonType &j, QString &s)
+{ const auto &str = j.template get_ref<const typename BasicJsonType::string_t &>();
+  s = QString::fromUtf8(str.data(), static_cast<qsizetype>(std::size(str))); }
+template <typename BasicJsonType>
+inline void from_json(const BasicJsonType &j, QUrl &u)
+{ u.setUrl(j.template get<QString>()); }
+template <typename BasicJsonType>
+inline void from_json(const BasicJsonType &j, QDateTime &d)
+{ d = QDateTime::fromSecsSinceEpoch(j.template get<qint64>()); }
+template <typename BasicJsonType>
+inline void from_json(const BasicJsonType &j, InternedString &s)
+{ s = InternedString(j.template get<QString>()); }
 // clang-format on
 
-template <typename Tp>
-inline void from_json(const nlohmann::json &j, QList<Tp> &list)
+template <typename BasicJsonType, typename Tp>
+inline void from_json(const BasicJsonType &j, QList<Tp> &list)
 {
     list.clear();
     if (!j.is_array()) {
@@ -1,21 +1,240 @@
 #include <QApplication>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QSettings>
+#include <QTextStream>
 #include <QTranslator>
 #include <QLibraryInfo>
 #include <QString>
+#include <QThread>
+#include <QtLogging>
+#include <QDebug>
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#  include <windows.h>
+#endif
 
 #include "main_window.hh"
 #include "asset_bag.hh"
 #include "my_decompose.hh"
+#include "collection_export_worker.hh"
+#include "batch_export.hh"
+#include "trace.hh"
+#include "request_metrics.hh"
 
 using namespace Qt::Literals;
 
+/// 带有 --export 或 --from-archive 时不创建任何窗口，只需要 QCoreApplication
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--export", 8) == 0
+            || std::strncmp(argv[i], "--from-archive", 14) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// 设置了 --trace 或环境变量 BILIBILICARDBROWSER_TRACE 时记录，退出时写入该文件
+class TraceSession
+{
+public:
+    explicit TraceSession(const QString &file_name) : file_name_(file_name)
+    {
+        QThread::currentThread()->setObjectName(u"main"_s);
+        if (file_name_.isEmpty()) {
+            return;
+        }
+#ifdef ENABLE_TRACING
+        Trace::start();
+#else
+        qWarning() << "Tracing is disabled at build time";
+        file_name_.clear();
+#endif
+    }
+    ~TraceSession()
+    {
+        if (!file_name_.isEmpty() && !Trace::stop(file_name_)) {
+            qWarning() << "Unable to write trace:" << file_name_;
+        }
+    }
+    Q_DISABLE_COPY_MOVE(TraceSession)
+
+private:
+    QString file_name_;
+};
+
+/// Cookie 的来源依次为：标准输入（--cookie-stdin）、环境变量 BILIBILI_COOKIE、conf.ini
+static QString headlessCookie(bool from_stdin)
+{
+    if (from_stdin) {
+        QTextStream in(stdin);
+        return in.readLine().trimmed();
+    }
+
+    const QString cookie = qEnvironmentVariable("BILIBILI_COOKIE").trimmed();
+    if (!cookie.isEmpty()) {
+        return cookie;
+    }
+
+    QSettings settings(u"conf.ini"_s, QSettings::Format::IniFormat);
+    settings.beginGroup("Network");
+    return settings.value("cookie").toString();
+}
+
+static int runHeadless(int argc, char *argv[])
+{
+    // NOLINTBEGIN(readability-static-accessed-through-instance)
+    QCoreApplication app(argc, argv);
+
+#ifdef Q_OS_WIN
+    // Release 构建是 GUI 子系统程序，需要手动连接到父进程的控制台
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+        std::freopen("CONOUT$", "w", stderr);
+    }
+#endif
+
+    app.setApplicationName(u"我的小卡片"_s);
+    app.setApplicationVersion(APPLICATION_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(u"无界面导出收藏集到 CSV 文件（以 .gz/.br 结尾时压缩）"_s);
+    parser.addHelpOption();
+    parser.addVersionOption();
+    const QCommandLineOption export_option(u"export"_s, u"导出到 <file>"_s, u"file"_s);
+    const QCommandLineOption from_archive_option(u"from-archive"_s,
+                                                 u"不访问网络，从存档 <archive> 重新生成"_s,
+                                                 u"archive"_s);
+    const QCommandLineOption archive_option(
+            u"archive"_s, u"将原始响应追加到存档 <archive>（.jsonl 或 .jsonl.gz）"_s, u"archive"_s);
+    const QCommandLineOption cookie_stdin_option(u"cookie-stdin"_s,
+                                                 u"从标准输入的第一行读取 Cookie"_s);
+    const QCommandLineOption accounts_option(
+            u"accounts"_s,
+            u"从 <file> 读取多个账号并发导出，每行为 名称<Tab>Cookie[<Tab>请求间隔毫秒]"_s,
+            u"file"_s);
+    const QCommandLineOption merge_option(u"merge"_s,
+                                          u"多账号导出时合并为一个文件，第一列为账号"_s);
+    const QCommandLineOption trace_option(
+            u"trace"_s, u"将各阶段的耗时以 Chrome trace 格式写入 <file>"_s, u"file"_s);
+    const QCommandLineOption metrics_option(
+            u"metrics"_s, u"结束时将各接口的耗时分位数以 JSON 格式写入 <file>"_s, u"file"_s);
+    const QCommandLineOption report_option(
+            u"report"_s, u"单账号导出结束时将统计报告以 JSON 格式写入 <file>"_s, u"file"_s);
+    parser.addOptions({ export_option, from_archive_option, archive_option, cookie_stdin_option,
+                        accounts_option, merge_option, trace_option, metrics_option,
+                        report_option });
+    parser.process(app);
+
+    const TraceSession trace_session(parser.isSet(trace_option)
+                                             ? parser.value(trace_option)
+                                             : qEnvironmentVariable("BILIBILICARDBROWSER_TRACE"));
+
+    QTextStream err(stderr);
+
+    if (!parser.isSet(export_option)) {
+        err << "--export <file> is required\n";
+        return 2;
+    }
+
+    int exit_code = 0;
+
+    if (parser.isSet(accounts_option)) {
+        bool ok;
+        const QList<ExportAccount> accounts =
+                BatchExportController::readAccounts(parser.value(accounts_option), &ok);
+        if (!ok || accounts.isEmpty()) {
+            err << "No account found in " << parser.value(accounts_option) << '\n';
+            return 2;
+        }
+
+        BatchExportController controller;
+        QObject::connect(&controller, &BatchExportController::progressChanged, &app,
+                         [&err](const QString &account_name, int current, int total) {
+                             err << u"[%1] 导出中... %2/%3"_s.arg(account_name).arg(current).arg(
+                                     total)
+                                 << Qt::endl;
+                         });
+        QObject::connect(&controller, &BatchExportController::errorOccurred, &app,
+                         [&err, &exit_code](const QString &account_name, const QString &message) {
+                             err << u"[%1] %2"_s.arg(account_name, message) << Qt::endl;
+                             exit_code = 1;
+                         });
+        QObject::connect(
+                &controller, &BatchExportController::finished, &app,
+                [&exit_code]() { QCoreApplication::exit(exit_code); }, Qt::QueuedConnection);
+
+        controller.exportToCsvFiles(accounts, parser.value(export_option),
+                                    parser.isSet(merge_option));
+        const int ret = app.exec();
+        if (parser.isSet(metrics_option)) {
+            RequestMetrics::instance().save(parser.value(metrics_option));
+        }
+        return ret;
+    }
+
+    CollectionExportWorker worker;
+
+    QObject::connect(&worker, &CollectionExportWorker::progressChanged, &app,
+                     [&err](int current, int total) {
+                         err << u"导出中... %1/%2"_s.arg(current).arg(total) << Qt::endl;
+                     });
+    QObject::connect(&worker, &CollectionExportWorker::errorOccurred, &app,
+                     [&err, &exit_code](const QString &message) {
+                         err << message << Qt::endl;
+                         exit_code = 1;
+                     });
+    // finished() 可能在 exec() 之前就发出（例如无法打开文件），使用队列连接
+    QObject::connect(
+            &worker, &CollectionExportWorker::finished, &app,
+            [&exit_code]() { QCoreApplication::exit(exit_code); }, Qt::QueuedConnection);
+
+    if (parser.isSet(report_option)) {
+        worker.setReportFileName(parser.value(report_option));
+    }
+    if (parser.isSet(from_archive_option)) {
+        worker.exportArchiveToCsvFile(parser.value(from_archive_option),
+                                      parser.value(export_option));
+    } else {
+        const QString cookie = headlessCookie(parser.isSet(cookie_stdin_option));
+        if (cookie.isEmpty()) {
+            err << "No cookie found in stdin, BILIBILI_COOKIE or conf.ini\n";
+            return 2;
+        }
+        if (parser.isSet(archive_option)) {
+            worker.setArchiveFileName(parser.value(archive_option));
+        }
+        worker.exportToCsvFile(parser.value(export_option), cookie);
+    }
+
+    const int ret = app.exec();
+    if (parser.isSet(metrics_option)) {
+        RequestMetrics::instance().save(parser.value(metrics_option));
+    }
+    if (ret == 0) {
+        err << u"导出完成"_s << Qt::endl;
+    }
+    return ret;
+    // NOLINTEND(readability-static-accessed-through-instance)
+}
+
 int main(int argc, char *argv[])
 {
+    if (isHeadless(argc, argv)) {
+        return runHeadless(argc, argv);
+    }
+
     // NOLINTBEGIN(readability-static-accessed-through-instance)
     QApplication app(argc, argv);
 
     qRegisterMetaType<MyDecomposeData>("MyDecomposeData");
     qRegisterMetaType<AssetBagData>("AssetBagData");
+    qRegisterMetaType<CardStore>("CardStore");
+    qRegisterMetaType<ExportStatistics>("ExportStatistics");
 
     app.setApplicationName(u"我的小卡片"_s);
     app.setApplicationVersion(APPLICATION_VERSION);
@@ -29,6 +248,7 @@ int main(int argc, char *argv[])
         qWarning() << "Failed to load translations";
     }
 
+    const TraceSession trace_session(qEnvironmentVariable("BILIBILICARDBROWSER_TRACE"));
     MainWindow win;
     win.show();
 
@@ -5,16 +5,39 @@
 #include <QStatusBar>
 #include <QPushButton>
 #include <QCheckBox>
+#include <QLabel>
 #include <QFileDialog>
 #include <QList>
+#include <QStringList>
 #include <QInputDialog>
+#include <QTime>
+#include <QElapsedTimer>
+#include <QSignalBlocker>
+#include <QNetworkInformation>
+#include <QSystemTrayIcon>
+#include <QStyle>
 #include <QOverload>
 #include <QtLogging>
 #include <QDebug>
 
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
 #include "main_window.hh"
 #include "my_decompose.hh"
 #include "asset_bag.hh"
+#include "card_search.hh"
+#include "tab_memory_manager.hh"
+#include "snapshot.hh"
+#include "compress_helper.hh"
+#include "offline_store.hh"
+#include "adaptive_poller.hh"
+#include "trace.hh"
+#include "request_metrics.hh"
+#include "metrics_dialog.hh"
+#include "stall_detector.hh"
+#include "allocation_accounting.hh"
 
 using namespace Qt::Literals;
 
@@ -24,11 +47,29 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
       network_thread_(),
       manager_(),
       worker_(),
+      prefetcher_(),
+      card_index_(),
+      response_cache_(),
       splitter_(new QSplitter(Qt::Horizontal)),
+      left_splitter_(new QSplitter(Qt::Vertical)),
       my_decompose_(new MyDecompose),
+      card_search_(new CardSearch),
       tab_widget_(new QTabWidget),
+      tab_memory_manager_(new TabMemoryManager(tab_widget_, &response_cache_, this)),
       set_cookie_button_(new QPushButton(u"设置 Cookie"_s)),
-      save_cookie_check_box_(new QCheckBox(u"将 Cookie 存储在本地"_s))
+      save_cookie_check_box_(new QCheckBox(u"将 Cookie 存储在本地"_s)),
+      archive_check_box_(new QCheckBox(u"导出时存档原始响应"_s)),
+      offline_check_box_(new QCheckBox(u"离线模式"_s)),
+      watch_check_box_(new QCheckBox(u"监视"_s)),
+      watch_poller_(new AdaptivePoller(this)),
+      watch_polling_(),
+      tray_icon_(),
+      stale_label_(new QLabel),
+      export_archive_button_(new QPushButton(u"从存档导出"_s)),
+      metrics_button_(new QPushButton(u"统计"_s)),
+      metrics_dialog_(),
+      stall_detector_(new StallDetector(this)),
+      prefetch_count_(5)
 {
     setWindowTitle(
             u"我的小卡片 v%1 (Commit: %2)"_s.arg(qApp->applicationVersion()).arg(GIT_COMMIT_HASH));
@@ -40,46 +81,192 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
         if (map_.remove(ActIdAndLotteryId(asset_bag->actId(), asset_bag->lotteryId())) != 1) {
             Q_UNREACHABLE();
         }
+        tab_memory_manager_->remove(asset_bag);
+        stale_asset_bags_.remove(qMakePair(asset_bag->actId(), asset_bag->lotteryId()));
+        response_cache_.remove(asset_bag->actId(), asset_bag->lotteryId());
         tab_widget_->removeTab(index);
+        // removeTab() 不会删除页面
+        asset_bag->deleteLater();
     });
-    splitter_->addWidget(my_decompose_);
+    card_search_->setIndex(&card_index_);
+    connect(card_search_, &CardSearch::collectionRequested, this,
+            [this](int act_id, const QString &act_name, int lottery_id) {
+                auto iter = map_.constFind(ActIdAndLotteryId(act_id, lottery_id));
+                if (iter != map_.constEnd()) {
+                    tab_widget_->setCurrentWidget(iter.value());
+                    return;
+                }
+                openCollection(act_id, act_name, lottery_id);
+            });
+    left_splitter_->addWidget(my_decompose_);
+    left_splitter_->addWidget(card_search_);
+    splitter_->addWidget(left_splitter_);
     splitter_->addWidget(tab_widget_);
     setCentralWidget(splitter_);
 
     connect(set_cookie_button_, &QPushButton::clicked, this, &MainWindow::onSetCookieButtonClicked);
+    connect(archive_check_box_, &QCheckBox::toggled, this, [this](bool checked) {
+        QMetaObject::invokeMethod(&worker_, &CollectionExportWorker::setArchiveFileName,
+                                  checked ? archiveFileName() : QString());
+    });
+    connect(export_archive_button_, &QPushButton::clicked, this,
+            &MainWindow::exportArchiveToCsvFile);
+    connect(metrics_button_, &QPushButton::clicked, this, [this]() {
+        if (metrics_dialog_ == nullptr) {
+            metrics_dialog_ = new MetricsDialog(this);
+            metrics_dialog_->setStallDetector(stall_detector_);
+        }
+        metrics_dialog_->show();
+        metrics_dialog_->raise();
+        metrics_dialog_->activateWindow();
+    });
     connect(my_decompose_, &MyDecompose::refreshRequested, this, [this]() {
-        my_decompose_->clearMyDecomposeData();
+        QMetaObject::invokeMethod(&prefetcher_, &Prefetcher::userActivity);
+        // 不清空表格，响应到达后只更新变化的部分
         QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::getMyDecompose, 1);
         QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::getMyDecompose, 2);
     });
+    connect(offline_check_box_, &QCheckBox::toggled, this, [this](bool checked) {
+        QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::setOffline, checked);
+        QMetaObject::invokeMethod(&worker_, &CollectionExportWorker::setOffline, checked);
+        if (checked) {
+            QMetaObject::invokeMethod(&prefetcher_, &Prefetcher::stop);
+            watch_poller_->stop();
+        } else {
+            refreshStale();
+            if (watch_check_box_->isChecked()) {
+                watch_poller_->start();
+            }
+        }
+    });
+    connect(watch_check_box_, &QCheckBox::toggled, this, [this](bool checked) {
+        if (checked && !offline_check_box_->isChecked()) {
+            watch_poller_->start();
+        } else {
+            watch_poller_->stop();
+        }
+    });
+    // 平时每次只请求 scene 1，有变化时才请求 scene 2 与对应的标签页
+    connect(watch_poller_, &AdaptivePoller::pollRequested, this, [this]() {
+        watch_polling_ = true;
+        QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::getMyDecompose, 1);
+    });
     connect(my_decompose_, &MyDecompose::exportRequested, this, &MainWindow::exportToCsvFile);
-    connect(my_decompose_, &MyDecompose::detailRequested, &manager_,
-            qOverload<int, const QString &>(&BilibiliRequestManager::getAssetBag));
+    connect(my_decompose_, &MyDecompose::detailRequested, this,
+            [this](int act_id, const QString &act_name) { openCollection(act_id, act_name, 0); });
+    connect(&prefetcher_, &Prefetcher::prefetched, this,
+            [this](int act_id, const QString &act_name, int lottery_id, const CardStore &store,
+                   const QByteArray &data, const QByteArray &content_encoding) {
+                card_index_.update(act_id, lottery_id, act_name, store);
+                card_search_->refresh();
+                // 预取期间用户已经打开了
+                if (map_.contains(ActIdAndLotteryId(act_id, lottery_id))) {
+                    return;
+                }
+                prefetched_.insert(qMakePair(act_id, lottery_id),
+                                   PrefetchedCollection{ act_name, store, data, content_encoding });
+                updatePrefetchedUsage();
+            });
+    connect(tab_memory_manager_, &TabMemoryManager::prefetchedReleaseRequested, this, [this]() {
+        prefetched_.clear();
+        updatePrefetchedUsage();
+    });
+    // 与对应的 *DataReceived 同一线程发出，排队后先于它到达
+    connect(&manager_, &BilibiliRequestManager::cachedDataServed, this,
+            [this](const QString &key, const QDateTime &fetched_at) {
+                cached_delivery_.insert(key, fetched_at);
+            });
+    connect(&manager_, &BilibiliRequestManager::cacheMissed, this, [this](const QString &key) {
+        statusBar()->showMessage(u"离线缓存中没有 %1"_s.arg(key), 3000);
+    });
     connect(&manager_, &BilibiliRequestManager::myDecomposeDataReceived, this,
             &MainWindow::onMyDecomposeDataReceived);
+    // 在网络线程中直接连接，压缩后排队，仍先于 assetBagDataReceived 到达
+    connect(&manager_, &BilibiliRequestManager::assetBagReplyReceived, &manager_,
+            [this](int act_id, int lottery_id, QByteArray data, QByteArray content_encoding) {
+                ResponseCache::compressIdentity(&data, &content_encoding);
+                QMetaObject::invokeMethod(this, [this, act_id, lottery_id, data,
+                                                 content_encoding]() {
+                    pending_replies_.insert(qMakePair(act_id, lottery_id),
+                                            PendingReply{ data, content_encoding });
+                });
+            },
+            Qt::DirectConnection);
     connect(&manager_, &BilibiliRequestManager::assetBagDataReceived, this,
             &MainWindow::onAssetBagDataReceived);
+    connect(&manager_, &BilibiliRequestManager::assetBagRequestFailed, this,
+            [this](int act_id, int lottery_id) {
+                revalidating_.remove(qMakePair(act_id, lottery_id));
+                pending_replies_.remove(qMakePair(act_id, lottery_id));
+            });
 
     {
         QStatusBar *status_bar = statusBar();
         status_bar->addPermanentWidget(set_cookie_button_);
         status_bar->addPermanentWidget(save_cookie_check_box_);
+        status_bar->addPermanentWidget(archive_check_box_);
+        status_bar->addPermanentWidget(export_archive_button_);
+        status_bar->addPermanentWidget(offline_check_box_);
+        status_bar->addPermanentWidget(watch_check_box_);
+        status_bar->addPermanentWidget(metrics_button_);
+        status_bar->addWidget(stale_label_);
+        stale_label_->hide();
+    }
+
+    // 没有可用的后端时只能依靠请求失败时自动退回到缓存
+    if (QNetworkInformation::loadBackendByFeatures(QNetworkInformation::Feature::Reachability)) {
+        connect(QNetworkInformation::instance(), &QNetworkInformation::reachabilityChanged, this,
+                [this](QNetworkInformation::Reachability reachability) {
+                    if (reachability == QNetworkInformation::Reachability::Online
+                        && !offline_check_box_->isChecked()) {
+                        refreshStale();
+                    }
+                });
     }
 
+    network_thread_.setObjectName(u"network"_s);
     manager_.moveToThread(&network_thread_);
 
-    connect(&worker_, &CollectionExportWorker::progressChanged, this,
-            [this](int current, int total) {
-                statusBar()->showMessage(u"导出中... %1/%2"_s.arg(current).arg(total));
+    connect(&worker_, &CollectionExportWorker::statisticsChanged, this,
+            [this](const ExportStatistics &statistics) {
+                const qint64 eta = statistics.eta();
+                statusBar()->showMessage(
+                        u"导出中... %1/%2，%3 请求/秒，剩余约 %4"_s.arg(statistics.current)
+                                .arg(statistics.total)
+                                .arg(QString::number(statistics.requestsPerSecond(), 'f', 2))
+                                .arg(eta < 0 ? u"未知"_s
+                                             : QTime(0, 0).addMSecs(eta / 1000000).toString(
+                                                       u"mm:ss"_s)));
             });
     connect(&worker_, &CollectionExportWorker::finished, my_decompose_,
             &MyDecompose::enableExportButton);
+    connect(&worker_, &CollectionExportWorker::finished, export_archive_button_,
+            [this]() { export_archive_button_->setEnabled(true); });
     connect(&worker_, &CollectionExportWorker::finished, this,
             [this]() { statusBar()->showMessage(u"导出完成"_s, 3000); });
+    // 在 finished() 之后排队到达，覆盖“导出完成”
+    connect(&worker_, &CollectionExportWorker::errorOccurred, this, [this](const QString &message) {
+        QMetaObject::invokeMethod(
+                this, [this, message]() { statusBar()->showMessage(message, 5000); },
+                Qt::QueuedConnection);
+    });
     worker_.moveToThread(&network_thread_);
+    prefetcher_.moveToThread(&network_thread_);
+#ifdef ENABLE_ALLOCATION_ACCOUNTING
+    // 网络线程中的其他分配（主要是 QNetworkReply 收到的数据）都记为网络
+    connect(
+            &network_thread_, &QThread::started, &network_thread_,
+            []() { ALLOCATION_THREAD(Network); }, Qt::DirectConnection);
+#endif
     network_thread_.start();
+    QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::setCacheDirectory,
+                              cacheDirectory());
+    QMetaObject::invokeMethod(&worker_, &CollectionExportWorker::setCacheDirectory,
+                              cacheDirectory());
+    QMetaObject::invokeMethod(&prefetcher_, &Prefetcher::setCacheDirectory, cacheDirectory());
 
     loadSettings();
+    loadSnapshot();
 }
 
 MainWindow::~MainWindow()
@@ -108,10 +295,33 @@ void MainWindow::loadSettings()
     if (settings_.contains("splitter_size")) {
         splitter_->restoreState(settings_.value("splitter_size").toByteArray());
     }
+    if (settings_.contains("left_splitter_size")) {
+        left_splitter_->restoreState(settings_.value("left_splitter_size").toByteArray());
+    }
     settings_.endGroup();
 
     settings_.beginGroup("Network");
     save_cookie_check_box_->setChecked(settings_.value("save_cookie", false).toBool());
+    // 在请求之前切换，离线时启动也不会访问网络
+    offline_check_box_->setChecked(settings_.value("offline", false).toBool());
+    settings_.endGroup();
+
+    settings_.beginGroup("Watch");
+    watch_poller_->setIntervalRange(
+            std::chrono::seconds(settings_.value("min_interval_sec", 60).toInt()),
+            std::chrono::seconds(settings_.value("max_interval_sec", 1800).toInt()));
+    watch_check_box_->setChecked(settings_.value("enabled", false).toBool());
+    settings_.endGroup();
+
+    settings_.beginGroup("Watchdog");
+    stall_detector_->setThreshold(
+            settings_.value("threshold_msec", StallDetector::kDefaultThresholdMsec).toInt());
+    if (settings_.value("enabled", true).toBool()) {
+        stall_detector_->start();
+    }
+    settings_.endGroup();
+
+    settings_.beginGroup("Network");
     if (settings_.contains("cookie")) {
         const QString cookie = settings_.value("cookie").toString();
         if (!cookie.isEmpty()) {
@@ -121,6 +331,22 @@ void MainWindow::loadSettings()
         }
     }
     settings_.endGroup();
+
+    settings_.beginGroup("Export");
+    archive_check_box_->setChecked(settings_.value("archive_responses", false).toBool());
+    settings_.endGroup();
+
+    settings_.beginGroup("Prefetch");
+    prefetch_count_ = settings_.value("count", 5).toInt();
+    for (auto &&act_id : settings_.value("recent").toList()) {
+        recent_act_ids_.append(act_id.toInt());
+    }
+    settings_.endGroup();
+
+    settings_.beginGroup("Memory");
+    tab_memory_manager_->setBudget(settings_.value("tab_budget_mb", 256).toLongLong() * 1024
+                                   * 1024);
+    settings_.endGroup();
 }
 
 void MainWindow::saveSettings()
@@ -137,10 +363,28 @@ void MainWindow::saveSettings()
 
     settings_.beginGroup("Splitter");
     settings_.setValue("splitter_size", splitter_->saveState());
+    settings_.setValue("left_splitter_size", left_splitter_->saveState());
     settings_.endGroup();
 
     settings_.beginGroup("Network");
     settings_.setValue("save_cookie", save_cookie_check_box_->isChecked());
+    settings_.setValue("offline", offline_check_box_->isChecked());
+    settings_.endGroup();
+
+    settings_.beginGroup("Watch");
+    settings_.setValue("enabled", watch_check_box_->isChecked());
+    settings_.setValue("min_interval_sec",
+                       static_cast<qint64>(watch_poller_->minInterval().count() / 1000));
+    settings_.setValue("max_interval_sec",
+                       static_cast<qint64>(watch_poller_->maxInterval().count() / 1000));
+    settings_.endGroup();
+
+    settings_.beginGroup("Watchdog");
+    settings_.setValue("enabled", stall_detector_->isRunning());
+    settings_.setValue("threshold_msec", stall_detector_->threshold());
+    settings_.endGroup();
+
+    settings_.beginGroup("Network");
     if (save_cookie_check_box_->isChecked()) {
         QString cookie;
         QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::cookie,
@@ -152,19 +396,43 @@ void MainWindow::saveSettings()
         }
     }
     settings_.endGroup();
+
+    settings_.beginGroup("Export");
+    settings_.setValue("archive_responses", archive_check_box_->isChecked());
+    settings_.endGroup();
+
+    settings_.beginGroup("Prefetch");
+    settings_.setValue("count", prefetch_count_);
+    {
+        QVariantList recent;
+        for (const int act_id : std::as_const(recent_act_ids_)) {
+            recent.append(act_id);
+        }
+        settings_.setValue("recent", recent);
+    }
+    settings_.endGroup();
+
+    settings_.beginGroup("Memory");
+    settings_.setValue("tab_budget_mb", tab_memory_manager_->budget() / (1024 * 1024));
+    settings_.endGroup();
 }
 
 void MainWindow::exportToCsvFile()
 {
     const QString file_name = QFileDialog::getSaveFileName(this, u"导出到 CSV 文件"_s,
                                                            qApp->applicationDirPath() % "/a.csv",
-                                                           u"CSV 文件 (*.csv)"_s);
+                                                           u"CSV 文件 (*.csv);;"
+                                                           "Gzip 压缩的 CSV 文件 (*.csv.gz);;"
+                                                           "Brotli 压缩的 CSV 文件 (*.csv.br)"_s);
     if (file_name.isEmpty()) {
         statusBar()->showMessage(u"取消"_s, 3000);
         return;
     }
 
     my_decompose_->disableExportButton();
+    export_archive_button_->setDisabled(true);
+    // 导出自己控制请求频率，预取只会让它更容易被限流
+    QMetaObject::invokeMethod(&prefetcher_, &Prefetcher::stop);
     QString cookie;
     QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::cookie,
                               Qt::BlockingQueuedConnection, qReturnArg(cookie));
@@ -172,6 +440,36 @@ void MainWindow::exportToCsvFile()
                               cookie);
 }
 
+void MainWindow::exportArchiveToCsvFile()
+{
+    const QString archive_file_name = QFileDialog::getOpenFileName(
+            this, u"选择存档"_s, archiveFileName(), u"存档 (*.jsonl.gz *.jsonl)"_s);
+    if (archive_file_name.isEmpty()) {
+        statusBar()->showMessage(u"取消"_s, 3000);
+        return;
+    }
+
+    const QString file_name = QFileDialog::getSaveFileName(this, u"导出到 CSV 文件"_s,
+                                                           qApp->applicationDirPath() % "/a.csv",
+                                                           u"CSV 文件 (*.csv);;"
+                                                           "Gzip 压缩的 CSV 文件 (*.csv.gz);;"
+                                                           "Brotli 压缩的 CSV 文件 (*.csv.br)"_s);
+    if (file_name.isEmpty()) {
+        statusBar()->showMessage(u"取消"_s, 3000);
+        return;
+    }
+
+    my_decompose_->disableExportButton();
+    export_archive_button_->setDisabled(true);
+    QMetaObject::invokeMethod(&worker_, &CollectionExportWorker::exportArchiveToCsvFile,
+                              archive_file_name, file_name);
+}
+
+QString MainWindow::archiveFileName()
+{
+    return qApp->applicationDirPath() % "/archive.jsonl.gz";
+}
+
 void MainWindow::onSetCookieButtonClicked()
 {
     bool ok;
@@ -187,49 +485,407 @@ void MainWindow::onSetCookieButtonClicked()
 
 void MainWindow::onMyDecomposeDataReceived(int scene, const QByteArray &json)
 {
+    TRACE_SCOPE("gui", "onMyDecomposeDataReceived");
+    TRACE_FLOW_END("signal", "myDecomposeDataReceived", Trace::flowId(-1, scene));
+    const QDateTime fetched_at = cached_delivery_.take(OfflineStore::myDecomposeKey(scene));
+    if (fetched_at.isValid()) {
+        stale_my_decompose_.insert(scene, fetched_at);
+    } else {
+        stale_my_decompose_.remove(scene);
+    }
+    updateStaleLabel();
+
+    QElapsedTimer timer;
+    timer.start();
     bool ok;
-    const MyDecomposeData d = MyDecomposeData::fromJson(json, &ok);
+    int code;
+    const MyDecomposeData d = MyDecomposeData::fromJson(json, &ok, &code);
+    RequestMetrics::instance().recordParse(RequestMetrics::kMyDecompose, timer.nsecsElapsed(),
+                                           code);
     if (!ok) {
         statusBar()->showMessage(u"json 非法"_s, 3000);
         return;
     }
 
-    my_decompose_->setMyDecomposeData(scene, d);
+    const bool refresh = my_decompose_json_.contains(scene);
+    my_decompose_json_.insert(scene, json);
+    const QList<int> changed = my_decompose_->updateMyDecomposeData(scene, d);
+    if (scene == 1 && !fetched_at.isValid()) {
+        // 数量有变化的收藏集的预取结果已经过期，其余的保留
+        for (auto iter = prefetched_.begin(); iter != prefetched_.end();) {
+            iter = changed.contains(iter.key().first) ? prefetched_.erase(iter) : std::next(iter);
+        }
+        updatePrefetchedUsage();
+        // 监视模式的轮询每个间隔只发出这一个请求
+        if (!watch_polling_ && (!refresh || !changed.isEmpty())) {
+            startPrefetch(d);
+        }
+    }
+    // 缓存的数据不会比标签页中的新
+    if (refresh && !fetched_at.isValid()) {
+        refreshChangedTabs(changed);
+    }
+
+    if (scene == 1 && std::exchange(watch_polling_, false)) {
+        watch_poller_->reportResult(!changed.isEmpty());
+        if (!changed.isEmpty()) {
+            QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::getMyDecompose, 2);
+            notifyChanges(d, changed);
+        }
+    }
+}
+
+void MainWindow::notifyChanges(const MyDecomposeData &data, const QList<int> &act_ids)
+{
+    QStringList names;
+    for (auto &&item : data.list.value_or(QList<MyDecomposeData::ListItem>())) {
+        if (act_ids.contains(item.act_id)) {
+            names.append(item.act_name);
+        }
+    }
+    const QString message = std::size(names) <= 3
+            ? names.join(u"、"_s)
+            : u"%1 等 %2 个收藏集"_s.arg(names.first(3).join(u"、"_s)).arg(std::size(names));
+
+    statusBar()->showMessage(u"卡片有变化: %1"_s.arg(message), 10000);
+    QApplication::alert(this);
+    if (QSystemTrayIcon::isSystemTrayAvailable()) {
+        if (tray_icon_ == nullptr) {
+            tray_icon_ = new QSystemTrayIcon(
+                    windowIcon().isNull() ? style()->standardIcon(QStyle::SP_MessageBoxInformation)
+                                          : windowIcon(),
+                    this);
+            tray_icon_->show();
+        }
+        tray_icon_->showMessage(u"卡片有变化"_s, message);
+    }
+}
+
+void MainWindow::refreshChangedTabs(const QList<int> &act_ids)
+{
+    const QSet<int> changed(act_ids.cbegin(), act_ids.cend());
+    for (auto iter = map_.cbegin(); iter != map_.cend(); ++iter) {
+        const auto key = qMakePair(iter.key().act_id, iter.key().lottery_id);
+        // 正在后台刷新的不需要再请求
+        if (!changed.contains(key.first) || revalidating_.contains(key)) {
+            continue;
+        }
+        // 与快照相同，隐藏的标签页刷新后不会切换过去
+        if (iter.value() != tab_widget_->currentWidget()) {
+            revalidating_.insert(key);
+        }
+        QMetaObject::invokeMethod(
+                &manager_,
+                qOverload<int, const QString &, int>(&BilibiliRequestManager::getAssetBag),
+                key.first, iter.value()->actName(), key.second);
+    }
 }
 
-void MainWindow::onAssetBagDataReceived(int act_id, const QString &act_name,
-                                        [[maybe_unused]] int lottery_id, [[maybe_unused]] int ruid,
-                                        const QByteArray &json)
+void MainWindow::onAssetBagDataReceived(int act_id, const QString &act_name, int lottery_id,
+                                        [[maybe_unused]] int ruid, const QByteArray &json)
 {
+    TRACE_SCOPE("gui", "onAssetBagDataReceived");
+    TRACE_FLOW_END("signal", "assetBagDataReceived", Trace::flowId(act_id, lottery_id));
+    const QDateTime fetched_at =
+            cached_delivery_.take(OfflineStore::assetBagKey(act_id, lottery_id));
+    const PendingReply reply = pending_replies_.take(qMakePair(act_id, lottery_id));
+    QElapsedTimer timer;
+    timer.start();
     bool ok;
-    const AssetBagData d = AssetBagData::fromJson(json, &ok);
+    int code;
+    const CardStore d = CardStore::fromJson(json, &ok, &code);
+    RequestMetrics::instance().recordParse(RequestMetrics::kAssetBag, timer.nsecsElapsed(), code);
     if (!ok) {
+        revalidating_.remove(qMakePair(act_id, lottery_id));
         statusBar()->showMessage(u"json 非法"_s, 3000);
         return;
     }
 
+    // 关闭标签页后仍保留索引，双击搜索结果可以重新打开
+    card_index_.update(act_id, lottery_id, act_name, d);
+    card_search_->refresh();
+
+    AssetBag *asset_bag = assetBagTab(act_id, act_name, lottery_id);
+    setAssetBagStale(asset_bag, fetched_at);
+    if (!reply.data.isEmpty()) {
+        response_cache_.insert(act_id, lottery_id, reply.data, reply.content_encoding);
+    }
+    if (revalidating_.remove(qMakePair(act_id, lottery_id))
+        && asset_bag != tab_widget_->currentWidget()) {
+        // 启动后的后台刷新不切换标签页，隐藏的标签页等到显示时再从新的响应构建
+        asset_bag->unload();
+        asset_bag->releaseCardStore();
+        return;
+    }
+    asset_bag->clearAssetBagData();
+    asset_bag->setCardStore(d);
+    tab_widget_->setCurrentWidget(asset_bag);
+    tab_memory_manager_->touch(asset_bag);
+    recordAccess(act_id);
+}
+
+AssetBag *MainWindow::assetBagTab(int act_id, const QString &act_name, int lottery_id)
+{
     auto iter = map_.constFind(ActIdAndLotteryId(act_id, lottery_id));
     if (iter != map_.constEnd()) {
-        AssetBag *asset_bag = iter.value();
-        asset_bag->clearAssetBagData();
-        asset_bag->setAssetBagData(d);
-        tab_widget_->setCurrentWidget(asset_bag);
+        return iter.value();
+    }
+
+    ALLOCATION_SCOPE(Widgets);
+    AssetBag *asset_bag = new AssetBag;
+    map_.insert(ActIdAndLotteryId(act_id, lottery_id), asset_bag);
+    asset_bag->setInfo(act_id, act_name);
+    connect(asset_bag, &AssetBag::refreshRequested, &manager_,
+            qOverload<int, const QString &, int>(&BilibiliRequestManager::getAssetBag));
+    tab_widget_->addTab(asset_bag, act_name);
+    return asset_bag;
+}
+
+void MainWindow::setAssetBagStale(AssetBag *asset_bag, const QDateTime &fetched_at)
+{
+    const int index = tab_widget_->indexOf(asset_bag);
+    const auto key = qMakePair(asset_bag->actId(), asset_bag->lotteryId());
+    if (fetched_at.isValid()) {
+        stale_asset_bags_.insert(key);
+        tab_widget_->setTabText(index, asset_bag->actName() % u" (缓存)"_s);
+        tab_widget_->setTabToolTip(
+                index, u"离线数据，获取于 %1"_s.arg(fetched_at.toString(u"yyyy-MM-dd hh:mm"_s)));
     } else {
-        AssetBag *asset_bag = new AssetBag;
-        map_.insert(ActIdAndLotteryId(act_id, lottery_id), asset_bag);
-        asset_bag->setInfo(act_id, act_name);
-        connect(asset_bag, &AssetBag::refreshRequested, &manager_,
-                qOverload<int, const QString &, int>(&BilibiliRequestManager::getAssetBag));
-        asset_bag->setAssetBagData(d);
-        tab_widget_->addTab(asset_bag, act_name);
-        tab_widget_->setCurrentWidget(asset_bag);
+        stale_asset_bags_.remove(key);
+        tab_widget_->setTabText(index, asset_bag->actName());
+        tab_widget_->setTabToolTip(index, QString());
+    }
+}
+
+void MainWindow::updateStaleLabel()
+{
+    if (stale_my_decompose_.isEmpty()) {
+        stale_label_->hide();
+        return;
+    }
+    const QDateTime oldest = *std::min_element(stale_my_decompose_.cbegin(),
+                                               stale_my_decompose_.cend());
+    stale_label_->setText(
+            u"离线数据，获取于 %1"_s.arg(oldest.toString(u"yyyy-MM-dd hh:mm"_s)));
+    stale_label_->show();
+}
+
+void MainWindow::refreshStale()
+{
+    if (!stale_my_decompose_.isEmpty()) {
+        QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::getMyDecompose, 1);
+        QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::getMyDecompose, 2);
+    }
+    for (auto &&key : std::as_const(stale_asset_bags_)) {
+        auto iter = map_.constFind(ActIdAndLotteryId(key.first, key.second));
+        if (iter == map_.constEnd()) {
+            continue;
+        }
+        // 与快照相同，隐藏的标签页刷新后不会切换过去
+        if (iter.value() != tab_widget_->currentWidget()) {
+            revalidating_.insert(key);
+        }
+        QMetaObject::invokeMethod(
+                &manager_,
+                qOverload<int, const QString &, int>(&BilibiliRequestManager::getAssetBag),
+                key.first, iter.value()->actName(), key.second);
+    }
+}
+
+void MainWindow::openCollection(int act_id, const QString &act_name, int lottery_id)
+{
+    QMetaObject::invokeMethod(&prefetcher_, &Prefetcher::userActivity);
+    // 明确打开的收藏集即使正在后台刷新，结果到达时也要切换过去
+    revalidating_.remove(qMakePair(act_id, lottery_id));
+
+    auto iter = prefetched_.find(qMakePair(act_id, lottery_id));
+    if (iter == prefetched_.end()) {
+        QMetaObject::invokeMethod(
+                &manager_,
+                qOverload<int, const QString &, int>(&BilibiliRequestManager::getAssetBag),
+                act_id, act_name, lottery_id);
+        return;
     }
+
+    const PrefetchedCollection prefetched = std::move(iter.value());
+    prefetched_.erase(iter);
+    updatePrefetchedUsage();
+    response_cache_.insert(act_id, lottery_id, prefetched.data, prefetched.content_encoding);
+    AssetBag *asset_bag = assetBagTab(act_id, act_name, lottery_id);
+    setAssetBagStale(asset_bag, QDateTime());
+    asset_bag->clearAssetBagData();
+    asset_bag->setCardStore(prefetched.store);
+    tab_widget_->setCurrentWidget(asset_bag);
+    tab_memory_manager_->touch(asset_bag);
+    recordAccess(act_id);
+}
+
+void MainWindow::updatePrefetchedUsage()
+{
+    qsizetype bytes = 0;
+    for (auto &&prefetched : std::as_const(prefetched_)) {
+        bytes += prefetched.store.memoryUsage() + std::size(prefetched.data);
+    }
+    tab_memory_manager_->setPrefetchedUsage(bytes);
+}
+
+void MainWindow::startPrefetch(const MyDecomposeData &data)
+{
+    if (prefetch_count_ <= 0 || offline_check_box_->isChecked() || !data.list.has_value()) {
+        return;
+    }
+
+    QList<MyDecomposeData::ListItem> items;
+    for (auto &&item : *data.list) {
+        if (!map_.contains(ActIdAndLotteryId(item.act_id, 0))) {
+            items.append(item);
+        }
+    }
+    const auto rank = [this](const MyDecomposeData::ListItem &item) {
+        const qsizetype index = recent_act_ids_.indexOf(item.act_id);
+        return qMakePair(index < 0 ? std::size(recent_act_ids_) : index, -item.card_num);
+    };
+    std::stable_sort(items.begin(), items.end(),
+                     [&rank](auto &&lhs, auto &&rhs) { return rank(lhs) < rank(rhs); });
+    if (std::size(items) > prefetch_count_) {
+        items.resize(prefetch_count_);
+    }
+    // 已经预取过且没有变化的不再请求
+    items.removeIf([this](const MyDecomposeData::ListItem &item) {
+        return prefetched_.contains(qMakePair(item.act_id, 0));
+    });
+    if (items.isEmpty()) {
+        return;
+    }
+
+    MyDecomposeData candidates;
+    candidates.list = items;
+    QString cookie;
+    QMetaObject::invokeMethod(&manager_, &BilibiliRequestManager::cookie,
+                              Qt::BlockingQueuedConnection, qReturnArg(cookie));
+    QMetaObject::invokeMethod(&prefetcher_, &Prefetcher::setCookie, cookie);
+    QMetaObject::invokeMethod(&prefetcher_, &Prefetcher::prefetch, candidates);
+}
+
+void MainWindow::recordAccess(int act_id)
+{
+    recent_act_ids_.removeOne(act_id);
+    recent_act_ids_.prepend(act_id);
+    if (std::size(recent_act_ids_) > 20) {
+        recent_act_ids_.resize(20);
+    }
+}
+
+void MainWindow::loadSnapshot()
+{
+    Snapshot snapshot;
+    if (!snapshot.open(snapshotFileName())) {
+        return;
+    }
+
+    AssetBag *current = nullptr;
+    {
+        // 只有退出时的当前标签页需要立即解析，其余的保持压缩，显示时再解析
+        const QSignalBlocker blocker(tab_widget_);
+        for (auto &&entry : snapshot.entries()) {
+            switch (entry.kind) {
+            case SnapshotEntry::MyDecompose: {
+                bool ok;
+                const QByteArray json = entry.json(&ok);
+                const MyDecomposeData d = ok ? MyDecomposeData::fromJson(json, &ok)
+                                             : MyDecomposeData();
+                if (ok) {
+                    my_decompose_json_.insert(entry.id, json);
+                    my_decompose_->setMyDecomposeData(entry.id, d);
+                }
+                break;
+            }
+            case SnapshotEntry::AssetBag: {
+                // data 引用映射的内存，snapshot 析构后失效，需要复制
+                response_cache_.insert(entry.id, entry.lottery_id,
+                                       QByteArray(entry.data.constData(), std::size(entry.data)),
+                                       entry.content_encoding);
+                AssetBag *asset_bag = assetBagTab(entry.id, entry.act_name, entry.lottery_id);
+                if (entry.current || current == nullptr) {
+                    current = asset_bag;
+                }
+                revalidating_.insert(qMakePair(entry.id, entry.lottery_id));
+                break;
+            }
+            default:
+                qWarning() << "Unknown snapshot entry:" << static_cast<int>(entry.kind);
+                break;
+            }
+        }
+    }
+
+    if (current != nullptr) {
+        tab_widget_->setCurrentWidget(current);
+        tab_memory_manager_->activate(current);
+    }
+
+    // 先显示快照中的数据，再在后台重新请求
+    for (auto &&key : std::as_const(revalidating_)) {
+        QMetaObject::invokeMethod(
+                &manager_,
+                qOverload<int, const QString &, int>(&BilibiliRequestManager::getAssetBag),
+                key.first, map_.value(ActIdAndLotteryId(key.first, key.second))->actName(),
+                key.second);
+    }
+}
+
+void MainWindow::saveSnapshot()
+{
+    QList<SnapshotEntry> entries;
+    for (auto iter = my_decompose_json_.cbegin(); iter != my_decompose_json_.cend(); ++iter) {
+        bool ok;
+        const QByteArray data = compressBrotli(iter.value(), &ok);
+        entries.append(SnapshotEntry{ SnapshotEntry::MyDecompose, false, iter.key(), 0, QString(),
+                                      ok ? "br"_ba : QByteArray(), ok ? data : iter.value() });
+    }
+    for (int i = 0; i < tab_widget_->count(); ++i) {
+        AssetBag *asset_bag = qobject_cast<AssetBag *>(tab_widget_->widget(i));
+        Q_ASSERT(asset_bag != nullptr);
+        QByteArray data;
+        QByteArray content_encoding;
+        if (response_cache_.compressedData(asset_bag->actId(), asset_bag->lotteryId(), &data,
+                                           &content_encoding)) {
+            entries.append(SnapshotEntry{ SnapshotEntry::AssetBag,
+                                          asset_bag == tab_widget_->currentWidget(),
+                                          asset_bag->actId(), asset_bag->lotteryId(),
+                                          asset_bag->actName(), content_encoding, data });
+        }
+    }
+
+    if (!Snapshot::write(snapshotFileName(), entries)) {
+        qWarning() << "Unable to write snapshot:" << snapshotFileName();
+    }
+}
+
+QString MainWindow::cacheDirectory()
+{
+    return qApp->applicationDirPath() % "/cache";
+}
+
+QString MainWindow::metricsFileName()
+{
+    return qApp->applicationDirPath() % "/metrics.json";
+}
+
+QString MainWindow::snapshotFileName()
+{
+    return qApp->applicationDirPath() % "/snapshot.bin";
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
     saveSettings();
+    // 之后等待其他线程的阻塞调用不算卡顿
+    stall_detector_->stop();
+    saveSnapshot();
     QMetaObject::invokeMethod(&worker_, &CollectionExportWorker::stopAction,
                               Qt::BlockingQueuedConnection);
+    QMetaObject::invokeMethod(&prefetcher_, &Prefetcher::stop, Qt::BlockingQueuedConnection);
+    RequestMetrics::instance().save(metricsFileName());
     QMainWindow::closeEvent(event);
 }
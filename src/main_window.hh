@@ -6,19 +6,35 @@
 #include <QThread>
 #include <QString>
 #include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QDateTime>
 
 #include "bilibili_request_manager.hh"
 #include "collection_export_worker.hh"
+#include "card_index.hh"
+#include "response_cache.hh"
+#include "my_decompose.hh"
+#include "card_store.hh"
+#include "prefetcher.hh"
 
 QT_BEGIN_NAMESPACE
 class QSplitter;
 class QPushButton;
 class QCheckBox;
+class QLabel;
 class QTabWidget;
+class QSystemTrayIcon;
 QT_END_NAMESPACE
 
 class MyDecompose;
 class AssetBag;
+class CardSearch;
+class TabMemoryManager;
+class AdaptivePoller;
+class MetricsDialog;
+class StallDetector;
 
 class MainWindow : public QMainWindow
 {
@@ -32,6 +48,7 @@ private slots:
     void loadSettings();
     void saveSettings();
     void exportToCsvFile();
+    void exportArchiveToCsvFile();
 
 private slots:
     void onSetCookieButtonClicked();
@@ -53,16 +70,84 @@ protected:
     void closeEvent(QCloseEvent *event) override;
 
 private:
+    [[nodiscard]] static QString archiveFileName();
+    [[nodiscard]] static QString snapshotFileName();
+    [[nodiscard]] static QString cacheDirectory();
+    [[nodiscard]] static QString metricsFileName();
+    /// 启动时从快照恢复 MyDecompose 与标签页，然后在后台重新请求
+    void loadSnapshot();
+    void saveSnapshot();
+    /// 查找或新建收藏集的标签页，不设置数据
+    AssetBag *assetBagTab(int act_id, const QString &act_name, int lottery_id);
+    /// fetched_at 无效表示数据来自网络
+    void setAssetBagStale(AssetBag *asset_bag, const QDateTime &fetched_at);
+    void updateStaleLabel();
+    /// 网络恢复或退出离线模式后，重新请求所有显示缓存数据的部分
+    void refreshStale();
+    /// 打开收藏集的标签页，已预取的直接显示，否则发出请求
+    void openCollection(int act_id, const QString &act_name, int lottery_id);
+    /// 从 scene 1 的列表中挑选最近打开过的、卡片最多的收藏集预取，跳过 prefetched_ 中已有的
+    void startPrefetch(const MyDecomposeData &data);
+    /// prefetched_ 计入 TabMemoryManager 的预算
+    void updatePrefetchedUsage();
+    void recordAccess(int act_id);
+    /// MyDecompose 中数量有变化的收藏集，重新请求已经打开的标签页
+    void refreshChangedTabs(const QList<int> &act_ids);
+    /// 监视模式下发现变化时通知，托盘不可用时只在状态栏显示
+    void notifyChanges(const MyDecomposeData &data, const QList<int> &act_ids);
+
     QSettings settings_;
     QThread network_thread_;
     BilibiliRequestManager manager_;
     CollectionExportWorker worker_;
+    Prefetcher prefetcher_;
+    CardIndex card_index_;
+    ResponseCache response_cache_;
     QSplitter *splitter_;
+    QSplitter *left_splitter_;
     MyDecompose *my_decompose_;
+    CardSearch *card_search_;
     QTabWidget *tab_widget_;
+    TabMemoryManager *tab_memory_manager_;
     QPushButton *set_cookie_button_;
     QCheckBox *save_cookie_check_box_;
+    QCheckBox *archive_check_box_;
+    QCheckBox *offline_check_box_;
+    QCheckBox *watch_check_box_;
+    AdaptivePoller *watch_poller_;
+    bool watch_polling_; ///< 下一个 scene 1 响应来自监视模式的轮询
+    QSystemTrayIcon *tray_icon_; ///< 第一次通知时创建
+    QLabel *stale_label_;
+    QPushButton *export_archive_button_;
+    QPushButton *metrics_button_;
+    MetricsDialog *metrics_dialog_; ///< 第一次打开时创建
+    StallDetector *stall_detector_;
     QMap<ActIdAndLotteryId, AssetBag *> map_;
+    QMap<int, QByteArray> my_decompose_json_; ///< {scene, 最近一次的响应}
+    /// 等待后台刷新、结果到达时不切换过去的 {act_id, lottery_id}，请求结束时移除
+    QSet<QPair<int, int>> revalidating_;
+    QHash<QString, QDateTime> cached_delivery_; ///< 即将到达的数据来自缓存，键为 OfflineStore 的键
+    QMap<int, QDateTime> stale_my_decompose_; ///< {scene, 缓存的获取时间}
+    QSet<QPair<int, int>> stale_asset_bags_;
+
+    struct PendingReply
+    {
+        QByteArray data; ///< 已在网络线程中压缩
+        QByteArray content_encoding;
+    };
+    /// 等待对应的 assetBagDataReceived，解析成功、打开标签页后才放入 response_cache_
+    QHash<QPair<int, int>, PendingReply> pending_replies_;
+
+    struct PrefetchedCollection
+    {
+        QString act_name;
+        CardStore store;
+        QByteArray data; ///< 压缩的响应，打开时放入 response_cache_
+        QByteArray content_encoding;
+    };
+    QHash<QPair<int, int>, PrefetchedCollection> prefetched_;
+    int prefetch_count_; ///< 每次刷新后最多预取的收藏集数，0 表示不预取
+    QList<int> recent_act_ids_; ///< 最近打开的收藏集，最新的在前
 };
 
 // clang-format off
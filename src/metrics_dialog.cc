@@ -0,0 +1,235 @@
+#include <QTreeWidget>
+#include <QTreeWidgetItem>
+#include <QPushButton>
+#include <QTimerEvent>
+#include <QSet>
+#include <QResizeEvent>
+#include <QtLogging>
+#include <QDebug>
+
+#include <chrono>
+
+#include "metrics_dialog.hh"
+#include "request_metrics.hh"
+#include "stall_detector.hh"
+
+using namespace Qt::Literals;
+
+namespace {
+
+QString formatDuration(qint64 nsecs)
+{
+    return QString::number(static_cast<double>(nsecs) / 1e6, 'f', 2) % " ms";
+}
+
+QString formatBytes(qint64 bytes)
+{
+    if (bytes < 1024) {
+        return QString::number(bytes) % " B";
+    }
+    if (bytes < 1024 * 1024) {
+        return QString::number(static_cast<double>(bytes) / 1024, 'f', 1) % " KiB";
+    }
+    return QString::number(static_cast<double>(bytes) / (1024 * 1024), 'f', 1) % " MiB";
+}
+
+/// 按第一列查找子项，没有时创建；就地更新以保留展开状态与滚动位置
+QTreeWidgetItem *childItem(QTreeWidgetItem *parent, const QString &name,
+                           QSet<QTreeWidgetItem *> *updated)
+{
+    QTreeWidgetItem *item = nullptr;
+    for (int i = 0; i < parent->childCount() && item == nullptr; ++i) {
+        if (parent->child(i)->text(0) == name) {
+            item = parent->child(i);
+        }
+    }
+    if (item == nullptr) {
+        item = new QTreeWidgetItem(parent, QStringList{ name });
+        item->setExpanded(true);
+    }
+    updated->insert(item);
+    return item;
+}
+
+/// 设置第一列之后的各列，不足的清空
+void setColumns(QTreeWidgetItem *item, const QStringList &columns)
+{
+    for (int i = 1; i < item->columnCount() || i <= std::size(columns); ++i) {
+        item->setText(i, columns.value(i - 1));
+    }
+}
+
+void setHistogram(QTreeWidgetItem *item, const Histogram &histogram, QString (*format)(qint64))
+{
+    setColumns(item, QStringList{
+                             QString::number(histogram.count()),
+                             format(histogram.percentile(0.5)),
+                             format(histogram.percentile(0.9)),
+                             format(histogram.percentile(0.99)),
+                             format(histogram.max()),
+                     });
+}
+
+/// 删除这次刷新中没有更新的项，例如清空后不再出现的 code
+void removeStale(QTreeWidgetItem *parent, const QSet<QTreeWidgetItem *> &updated)
+{
+    for (int i = parent->childCount() - 1; i >= 0; --i) {
+        QTreeWidgetItem *item = parent->child(i);
+        if (updated.contains(item)) {
+            removeStale(item, updated);
+        } else {
+            delete parent->takeChild(i);
+        }
+    }
+}
+
+} // namespace
+
+MetricsDialog::MetricsDialog(QWidget *parent, Qt::WindowFlags f)
+    : QDialog(parent, f),
+      timer_id_(Qt::TimerId::Invalid),
+      stall_detector_(),
+      tree_widget_(new QTreeWidget(this)),
+      clear_button_(new QPushButton(u"清空"_s, this)),
+      allocation_timer_(),
+      last_allocations_()
+{
+    setWindowTitle(u"请求统计"_s);
+    clear_button_->adjustSize();
+    tree_widget_->setColumnCount(6);
+    tree_widget_->setHeaderLabels(QStringList{
+            u"接口/阶段"_s,
+            u"次数"_s,
+            u"p50"_s,
+            u"p90"_s,
+            u"p99"_s,
+            u"最大"_s,
+    });
+    resize(720, 480);
+
+    connect(clear_button_, &QPushButton::clicked, this, [this]() {
+        RequestMetrics::instance().clear();
+        Allocation::resetPeaks();
+        refresh();
+    });
+}
+
+void MetricsDialog::refresh()
+{
+    const QMap<QString, RequestMetrics::Endpoint> endpoints = RequestMetrics::instance().snapshot();
+
+    QTreeWidgetItem *root = tree_widget_->invisibleRootItem();
+    QSet<QTreeWidgetItem *> updated;
+    const auto child = [&updated](QTreeWidgetItem *parent, const QString &name) {
+        return childItem(parent, name, &updated);
+    };
+    for (auto iter = endpoints.cbegin(); iter != endpoints.cend(); ++iter) {
+        const RequestMetrics::Endpoint &endpoint = iter.value();
+        QTreeWidgetItem *item = child(root, iter.key());
+        setColumns(item, QStringList{ QString::number(endpoint.total.count()) });
+        setHistogram(child(item, u"排队与连接"_s), endpoint.queue_wait, formatDuration);
+        setHistogram(child(item, u"首字节"_s), endpoint.time_to_first_byte, formatDuration);
+        setHistogram(child(item, u"总耗时"_s), endpoint.total, formatDuration);
+        setHistogram(child(item, u"解压"_s), endpoint.decompress, formatDuration);
+        setHistogram(child(item, u"解析"_s), endpoint.parse, formatDuration);
+        setHistogram(child(item, u"传输大小"_s), endpoint.received_bytes, formatBytes);
+        setHistogram(child(item, u"解压后大小"_s), endpoint.decoded_bytes, formatBytes);
+        for (auto error = endpoint.network_errors.cbegin(); error != endpoint.network_errors.cend();
+             ++error) {
+            setColumns(child(item, u"网络错误 %1"_s.arg(error.key())),
+                       QStringList{ QString::number(error.value()) });
+        }
+        for (auto code = endpoint.codes.cbegin(); code != endpoint.codes.cend(); ++code) {
+            setColumns(child(item, u"code %1"_s.arg(code.key())),
+                       QStringList{ QString::number(code.value()) });
+        }
+    }
+
+    if (stall_detector_ != nullptr && stall_detector_->isRunning()) {
+        const StallDetector::Statistics statistics = stall_detector_->statistics();
+        QTreeWidgetItem *item = child(root, u"GUI 事件循环"_s);
+        setColumns(item, QStringList{
+                                 QString::number(statistics.stalls.count()),
+                                 u"%1 次卡顿/分钟"_s.arg(
+                                         QString::number(statistics.stallsPerMinute(), 'f', 2)),
+                         });
+        setHistogram(child(item, u"延迟"_s), statistics.latency, formatDuration);
+        setHistogram(child(item, u"卡顿（>%1 ms）"_s.arg(stall_detector_->threshold())),
+                     statistics.stalls, formatDuration);
+        for (auto iter = statistics.culprits.cbegin(); iter != statistics.culprits.cend(); ++iter) {
+            setColumns(child(item, iter.key()), QStringList{ QString::number(iter.value()) });
+        }
+    }
+
+    if (Allocation::isEnabled()) {
+        const qint64 elapsed = allocation_timer_.isValid() ? allocation_timer_.nsecsElapsed() : 0;
+        allocation_timer_.start();
+        qint64 live_bytes = 0;
+        QTreeWidgetItem *item = child(root, u"内存"_s);
+        for (int i = 0; i < Allocation::kSubsystemCount; ++i) {
+            const auto subsystem = static_cast<Allocation::Subsystem>(i);
+            const Allocation::Counters counters = Allocation::counters(subsystem);
+            // 第一次刷新时还没有上一次的计数，不显示速率
+            QString rate;
+            if (elapsed > 0) {
+                const double per_second =
+                        static_cast<double>(counters.allocations - last_allocations_[i]) * 1e9
+                        / static_cast<double>(elapsed);
+                rate = u"%1 次/秒"_s.arg(QString::number(per_second, 'f', 0));
+            }
+            last_allocations_[i] = counters.allocations;
+            live_bytes += counters.live_bytes;
+            setColumns(child(item, QString::fromUtf8(Allocation::name(subsystem))),
+                       QStringList{
+                               QString::number(counters.allocations),
+                               u"现存 %1"_s.arg(formatBytes(counters.live_bytes)),
+                               u"峰值 %1"_s.arg(formatBytes(counters.peak_bytes)),
+                               rate,
+                               u"累计 %1"_s.arg(formatBytes(
+                                       static_cast<qint64>(counters.allocated_bytes))),
+                       });
+        }
+        setColumns(item, QStringList{ QString(), u"现存 %1"_s.arg(formatBytes(live_bytes)) });
+    }
+
+    removeStale(root, updated);
+    tree_widget_->resizeColumnToContents(0);
+}
+
+void MetricsDialog::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+    refresh();
+    if (timer_id_ == Qt::TimerId::Invalid) {
+        timer_id_ = static_cast<Qt::TimerId>(startTimer(std::chrono::seconds(1)));
+        if (timer_id_ == Qt::TimerId::Invalid) {
+            qWarning() << "Failed to start timer";
+        }
+    }
+}
+
+void MetricsDialog::hideEvent(QHideEvent *event)
+{
+    if (timer_id_ != Qt::TimerId::Invalid) {
+        killTimer(timer_id_);
+        timer_id_ = Qt::TimerId::Invalid;
+    }
+    QDialog::hideEvent(event);
+}
+
+void MetricsDialog::timerEvent(QTimerEvent *event)
+{
+    if (timer_id_ == event->id()) {
+        refresh();
+        return;
+    }
+    QDialog::timerEvent(event);
+}
+
+void MetricsDialog::resizeEvent(QResizeEvent *event)
+{
+    QDialog::resizeEvent(event);
+    const QSize size = event->size();
+    tree_widget_->resize(size.width(), size.height() - 2 - clear_button_->height());
+    clear_button_->move(tree_widget_->geometry().bottomLeft() + QPoint(0, 1));
+}
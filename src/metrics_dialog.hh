@@ -0,0 +1,48 @@
+#ifndef METRICS_DIALOG_HH
+#define METRICS_DIALOG_HH
+
+#include <QDialog>
+#include <QElapsedTimer>
+
+#include <array>
+
+#include "allocation_accounting.hh"
+
+QT_BEGIN_NAMESPACE
+class QTreeWidget;
+class QPushButton;
+QT_END_NAMESPACE
+
+class StallDetector;
+
+/// \brief 显示 RequestMetrics 中各个接口各阶段耗时的分位数与 GUI 线程的卡顿，打开期间每秒刷新
+///
+/// 以 ENABLE_ALLOCATION_ACCOUNTING 构建时还显示各子系统的现存、峰值内存与每秒分配次数。
+class MetricsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsDialog(QWidget *parent = nullptr, Qt::WindowFlags f = Qt::WindowFlags());
+
+    void setStallDetector(const StallDetector *stall_detector) { stall_detector_ = stall_detector; }
+
+public slots:
+    void refresh();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void timerEvent(QTimerEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    Qt::TimerId timer_id_;
+    const StallDetector *stall_detector_;
+    QTreeWidget *tree_widget_;
+    QPushButton *clear_button_;
+    QElapsedTimer allocation_timer_; ///< 上次刷新以来的时间，用于计算分配速率
+    std::array<quint64, Allocation::kSubsystemCount> last_allocations_;
+};
+
+#endif
@@ -7,17 +7,24 @@
 #include <QtLogging>
 #include <QDebug>
 #include <QtAssert>
+#include <QHash>
+#include <QSet>
 
+#include <algorithm>
+#include <functional>
 #include <iterator>
 
 #include "my_decompose.hh"
 #include "json_helper.hh"
+#include "trace.hh"
+#include "allocation_accounting.hh"
 
 using namespace Qt::Literals;
 
 void from_json(const nlohmann::json &j, MyDecomposeData::ListItem &item)
 {
-    j.at("act_name").get_to(item.act_name);
+    // 与卡片数据中的收藏集名共享同一份字符串
+    item.act_name = j.at("act_name").get<InternedString>().toString();
     j.at("act_id").get_to(item.act_id);
     j.at("card_num").get_to(item.card_num);
 }
@@ -31,38 +38,51 @@ void from_json(const nlohmann::json &j, MyDecomposeData &data)
     }
 }
 
-MyDecomposeData MyDecomposeData::fromJson(const QByteArray &json, bool *ok)
+MyDecomposeData MyDecomposeData::fromJson(const QByteArray &json, bool *ok, int *code_out)
 {
+    TRACE_SCOPE("parse", "MyDecomposeData::fromJson");
+    ALLOCATION_SCOPE(JsonParse);
     if (ok) {
         *ok = false;
     }
 
     MyDecomposeData d;
+    int code = -1;
 
-    do {
-        const nlohmann::json j = nlohmann::json::parse(json.toStdString(), nullptr, false);
-        if (j.is_discarded()) {
-            break;
-        }
+    try {
+        do {
+            const nlohmann::json j = nlohmann::json::parse(json.toStdString(), nullptr, false);
+            if (j.is_discarded()) {
+                break;
+            }
 
-        const int code = j.at("code").get<int>();
-        const std::string message = j.at("message").get<std::string>();
-        if (code != 0) {
-            qWarning() << "code:" << code << "message:" << message;
-            break;
-        }
+            code = j.at("code").get<int>();
+            const std::string message = j.at("message").get<std::string>();
+            if (code != 0) {
+                qWarning() << "code:" << code << "message:" << message;
+                break;
+            }
 
-        auto &&data = j.at("data");
-        if (!data.is_object()) {
-            break;
-        }
-        data.get_to(d);
+            auto &&data = j.at("data");
+            if (!data.is_object()) {
+                break;
+            }
+            data.get_to(d);
 
-        if (ok) {
-            *ok = true;
-        }
-    } while (false);
+            if (ok) {
+                *ok = true;
+            }
+        } while (false);
+    } catch (const nlohmann::json::exception &e) {
+        // 缺少字段或类型不符时 at() 与 get() 仍然会抛出异常，与解析失败同样处理
+        qWarning() << "Invalid response:" << e.what();
+        d = MyDecomposeData();
+        code = -1;
+    }
 
+    if (code_out) {
+        *code_out = code;
+    }
     return d;
 }
 
@@ -90,74 +110,125 @@ MyDecompose::MyDecompose(QWidget *parent, Qt::WindowFlags f)
 void MyDecompose::clearMyDecomposeData()
 {
     table_widget_->setRowCount(0);
-    map_.clear();
     // disable sorting before setting data
     table_widget_->setSortingEnabled(false);
 }
 
+namespace {
+
+// 我们需要存储卡片数量/种类数，重载比较运算符即可
+class MyWidgetItem : public QTableWidgetItem
+{
+    using QTableWidgetItem::QTableWidgetItem;
+    bool operator<(const QTableWidgetItem &other) const override
+    {
+        return text().toInt() < other.text().toInt();
+    }
+};
+
+} // namespace
+
 void MyDecompose::setMyDecomposeData(int scene, const MyDecomposeData &data)
 {
+    updateMyDecomposeData(scene, data);
+}
+
+QList<int> MyDecompose::updateMyDecomposeData(int scene, const MyDecomposeData &data)
+{
+    TRACE_SCOPE("gui", "MyDecompose::updateMyDecomposeData");
+    ALLOCATION_SCOPE(Widgets);
     Q_ASSERT(scene == 1 || scene == 2);
 
     if (!data.list.has_value()) {
-        return;
+        return {};
     }
 
-    // 我们需要存储卡片数量/种类数，重载比较运算符即可
-    class MyWidgetItem : public QTableWidgetItem
-    {
-        using QTableWidgetItem::QTableWidgetItem;
-        bool operator<(const QTableWidgetItem &other) const override
-        {
-            return text().toInt() < other.text().toInt();
-        }
-    };
+    const int column = scene == 1 ? 2 : 3;
+    const bool empty = table_widget_->rowCount() == 0;
+    const bool sorting = table_widget_->isSortingEnabled();
+    // 排序会移动行，先关闭，结束后再恢复
+    table_widget_->setSortingEnabled(false);
 
-    if (table_widget_->rowCount() == 0) {
+    // 排序后行号会变化，每次都按第二列重新建立索引
+    QHash<int, int> rows; // {act_id, row}
+    rows.reserve(table_widget_->rowCount());
+    for (int row = 0; row < table_widget_->rowCount(); ++row) {
+        rows.insert(table_widget_->item(row, 1)->text().toInt(), row);
+    }
+    if (empty) {
         table_widget_->setRowCount(
                 std::size(data.list.value())); // NOLINT(cppcoreguidelines-narrowing-conversions)
-        for (int i = 0; i < static_cast<int>(std::size(data.list.value())); ++i) {
-            QLabel *act_name = new QLabel(
-                    u"<a href=\"https://www.bilibili.com/h5/mall/digital-card/home?-Abrowser=live&act_id=%1&hybrid_set_header=2\">%2</a>"_s
-                            .arg(data.list->at(i).act_id)
-                            .arg(data.list->at(i).act_name));
-            act_name->setTextInteractionFlags(Qt::TextBrowserInteraction);
-            act_name->setOpenExternalLinks(true);
-            table_widget_->setCellWidget(i, 0, act_name);
-            table_widget_->setItem(i, 1,
-                                   new QTableWidgetItem(QString::number(data.list->at(i).act_id)));
-            table_widget_->setItem(i, scene == 1 ? 2 : 3,
-                                   new MyWidgetItem(QString::number(data.list->at(i).card_num)));
-            QPushButton *detail_button = new QPushButton(u"详细"_s);
-            connect(detail_button, &QPushButton::clicked, this,
-                    [this, act_id = data.list->at(i).act_id,
-                     act_name = data.list->at(i).act_name]() {
-                        emit detailRequested(act_id, act_name);
-                    });
-            table_widget_->setCellWidget(i, 4, detail_button);
-            map_[data.list->at(i).act_id] = i;
-        }
-    } else {
-        for (int i = 0; i < static_cast<int>(std::size(data.list.value())); ++i) {
-            auto iter = map_.constFind(data.list->at(i).act_id);
-            if (iter == map_.constEnd()) {
-                qWarning() << "Unknown act_id:" << data.list->at(i).act_id;
-                continue;
+    }
+
+    QList<int> changed;
+    QSet<int> seen;
+    int next_row = 0;
+    for (auto &&item : data.list.value()) {
+        seen.insert(item.act_id);
+        const QString card_num = QString::number(item.card_num);
+        auto iter = rows.constFind(item.act_id);
+        if (iter == rows.constEnd()) {
+            const int row = empty ? next_row++ : table_widget_->rowCount();
+            if (!empty) {
+                table_widget_->insertRow(row);
             }
-            if (QTableWidgetItem *item = table_widget_->item(iter.value(), scene == 1 ? 2 : 3)) {
-                Q_ASSERT(dynamic_cast<MyWidgetItem *>(item) != nullptr);
-                item->setText(QString::number(data.list->at(i).card_num));
-            } else {
-                table_widget_->setItem(
-                        iter.value(), scene == 1 ? 2 : 3,
-                        new MyWidgetItem(QString::number(data.list->at(i).card_num)));
+            fillRow(row, item.act_id, item.act_name);
+            table_widget_->setItem(row, column, new MyWidgetItem(card_num));
+            rows.insert(item.act_id, row);
+            changed.append(item.act_id);
+        } else if (QTableWidgetItem *cell = table_widget_->item(iter.value(), column)) {
+            Q_ASSERT(dynamic_cast<MyWidgetItem *>(cell) != nullptr);
+            if (cell->text() != card_num) {
+                cell->setText(card_num);
+                changed.append(item.act_id);
             }
+        } else {
+            table_widget_->setItem(iter.value(), column, new MyWidgetItem(card_num));
+            changed.append(item.act_id);
+        }
+    }
+
+    // 这个 scene 中已经没有的收藏集清空对应的格子，两个 scene 中都没有时删除整行
+    QList<int> removed_rows;
+    for (auto iter = rows.cbegin(); iter != rows.cend(); ++iter) {
+        if (seen.contains(iter.key())) {
+            continue;
+        }
+        if (QTableWidgetItem *cell = table_widget_->takeItem(iter.value(), column)) {
+            delete cell;
+            changed.append(iter.key());
+        }
+        if (table_widget_->item(iter.value(), scene == 1 ? 3 : 2) == nullptr) {
+            removed_rows.append(iter.value());
         }
-        // enable sorting after setting all data
-        table_widget_->setSortingEnabled(true);
-        // `map_` should not be used from now on...
     }
-    table_widget_->resizeColumnsToContents();
+    std::sort(removed_rows.begin(), removed_rows.end(), std::greater<int>());
+    for (const int row : std::as_const(removed_rows)) {
+        table_widget_->removeRow(row);
+    }
+
+    // 第一次设置数据时等到另一个 scene 也到达后再排序
+    table_widget_->setSortingEnabled(sorting || !empty);
+    if (!changed.isEmpty()) {
+        table_widget_->resizeColumnsToContents();
+    }
+    return changed;
+}
+
+void MyDecompose::fillRow(int row, int act_id, const QString &act_name)
+{
+    QLabel *act_name_label = new QLabel(
+            u"<a href=\"https://www.bilibili.com/h5/mall/digital-card/home?-Abrowser=live&act_id=%1&hybrid_set_header=2\">%2</a>"_s
+                    .arg(act_id)
+                    .arg(act_name));
+    act_name_label->setTextInteractionFlags(Qt::TextBrowserInteraction);
+    act_name_label->setOpenExternalLinks(true);
+    table_widget_->setCellWidget(row, 0, act_name_label);
+    table_widget_->setItem(row, 1, new QTableWidgetItem(QString::number(act_id)));
+    QPushButton *detail_button = new QPushButton(u"详细"_s);
+    connect(detail_button, &QPushButton::clicked, this,
+            [this, act_id, act_name]() { emit detailRequested(act_id, act_name); });
+    table_widget_->setCellWidget(row, 4, detail_button);
 }
 
 void MyDecompose::disableExportButton()
@@ -4,7 +4,6 @@
 #include <QWidget>
 #include <QByteArray>
 #include <QList>
-#include <QMap>
 
 #include <optional>
 
@@ -15,7 +14,9 @@ QT_END_NAMESPACE
 
 struct MyDecomposeData
 {
-    static MyDecomposeData fromJson(const QByteArray &json, bool *ok = nullptr);
+    /// \param code 非空时设置响应中的 code，无法解析时为 -1
+    static MyDecomposeData fromJson(const QByteArray &json, bool *ok = nullptr,
+                                    int *code = nullptr);
 
     struct ListItem
     {
@@ -47,14 +48,21 @@ public slots:
     void disableExportButton();
     void enableExportButton();
 
+public:
+    /// 按 act_id 与当前表格比较，只修改变化的格子，新的收藏集追加到末尾，两个 scene 中都没有的行被删除；
+    /// 返回数量有变化（包括新增、删除）的 act_id
+    QList<int> updateMyDecomposeData(int scene, const MyDecomposeData &data);
+
 protected:
     void resizeEvent(QResizeEvent *event) override;
 
 private:
+    /// 填充除卡片数量/种类数以外的列
+    void fillRow(int row, int act_id, const QString &act_name);
+
     QTableWidget *table_widget_;
     QPushButton *refresh_button_;
     QPushButton *export_button_;
-    QMap<int, int> map_; // {act_id, row_id}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtLogging>
+#include <QDebug>
+
+#include "offline_store.hh"
+
+using namespace Qt::Literals;
+
+void OfflineStore::setDirectory(const QString &dir)
+{
+    dir_ = dir;
+    bytes_ = 0;
+    if (!dir_.isEmpty() && !QDir().mkpath(dir_)) {
+        qWarning() << "Unable to create cache directory:" << dir_;
+        dir_.clear();
+    }
+    prune();
+}
+
+bool OfflineStore::store(const QString &key, const QByteArray &data,
+                         const QByteArray &content_encoding)
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    QSaveFile file(fileName(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Unable to write cache:" << file.fileName();
+        return false;
+    }
+    file.write(content_encoding);
+    file.write("\n", 1);
+    file.write(data);
+    if (!file.commit()) {
+        return false;
+    }
+
+    // 覆盖的旧文件不扣除，最多提前一些 prune()
+    bytes_ += std::size(content_encoding) + 1 + std::size(data);
+    if (capacity_ > 0 && bytes_ > capacity_) {
+        prune();
+    }
+    return true;
+}
+
+bool OfflineStore::load(const QString &key, QByteArray *data, QByteArray *content_encoding,
+                        QDateTime *fetched_at) const
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    QFile file(fileName(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray content = file.readAll();
+    const qsizetype eol = content.indexOf('\n');
+    if (eol < 0) {
+        qWarning() << "Corrupted cache:" << file.fileName();
+        return false;
+    }
+
+    *content_encoding = content.first(eol);
+    *data = content.sliced(eol + 1);
+    if (fetched_at) {
+        *fetched_at = QFileInfo(file).lastModified();
+    }
+    return true;
+}
+
+QString OfflineStore::myDecomposeKey(int scene)
+{
+    return u"my_decompose_%1"_s.arg(scene);
+}
+
+QString OfflineStore::assetBagKey(int act_id, int lottery_id)
+{
+    return u"asset_bag_%1_%2"_s.arg(act_id).arg(lottery_id);
+}
+
+QString OfflineStore::imageKey(long long card_type_id)
+{
+    return u"image_%1"_s.arg(card_type_id);
+}
+
+void OfflineStore::prune()
+{
+    if (!isEnabled() || capacity_ <= 0) {
+        return;
+    }
+
+    // 最早获取的在前
+    const QFileInfoList files =
+            QDir(dir_).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    bytes_ = 0;
+    for (const QFileInfo &info : files) {
+        bytes_ += info.size();
+    }
+    if (bytes_ <= capacity_) {
+        return;
+    }
+    // 删到 3/4，以免之后每次写入都重新统计
+    for (const QFileInfo &info : files) {
+        if (bytes_ <= capacity_ / 4 * 3) {
+            break;
+        }
+        if (QFile::remove(info.filePath())) {
+            bytes_ -= info.size();
+        } else {
+            qWarning() << "Unable to remove cache:" << info.filePath();
+        }
+    }
+}
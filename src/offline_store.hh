@@ -0,0 +1,50 @@
+#ifndef OFFLINE_STORE_HH
+#define OFFLINE_STORE_HH
+
+#include <QByteArray>
+#include <QString>
+#include <QDateTime>
+
+/// \brief 磁盘上的响应缓存，离线时代替网络
+///
+/// 每个响应一个文件，第一行为 Content-Encoding（可为空），之后是未解压的原始数据。
+/// 文件的修改时间即获取时间。目录为空时不读写任何文件。
+///
+/// 目录总大小超过 capacity() 时从最早获取的文件开始删除，直到不超过其 3/4。
+/// 写入的大小只在本实例中累计，多个实例共用同一目录时上限是近似的。
+class OfflineStore
+{
+public:
+    static constexpr qint64 kDefaultCapacity = 256LL * 1024 * 1024;
+
+    OfflineStore() = default;
+    explicit OfflineStore(const QString &dir) { setDirectory(dir); }
+
+    /// 目录不存在时会创建，超出上限时立即删除
+    void setDirectory(const QString &dir);
+    [[nodiscard]] qint64 capacity() const { return capacity_; }
+    /// 0 表示不限制，应在 setDirectory() 之前设置
+    void setCapacity(qint64 bytes) { capacity_ = bytes; }
+    [[nodiscard]] QString directory() const { return dir_; }
+    [[nodiscard]] bool isEnabled() const { return !dir_.isEmpty(); }
+
+    bool store(const QString &key, const QByteArray &data, const QByteArray &content_encoding);
+    /// 不存在时返回 false
+    bool load(const QString &key, QByteArray *data, QByteArray *content_encoding,
+              QDateTime *fetched_at = nullptr) const;
+
+    [[nodiscard]] static QString myDecomposeKey(int scene);
+    [[nodiscard]] static QString assetBagKey(int act_id, int lottery_id);
+    [[nodiscard]] static QString imageKey(long long card_type_id);
+
+private:
+    [[nodiscard]] QString fileName(const QString &key) const { return dir_ % u'/' % key; }
+    /// 重新统计目录大小，超过 capacity_ 时删除最早获取的文件
+    void prune();
+
+    QString dir_;
+    qint64 capacity_ = kDefaultCapacity;
+    qint64 bytes_ = 0; ///< 目录的大小，上次 prune() 之后只累计本实例写入的
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include <QTimerEvent>
+#include <QtLogging>
+#include <QDebug>
+
+#include <chrono>
+
+#include "prefetcher.hh"
+#include "bilibili_request_manager.hh"
+#include "card_store.hh"
+#include "response_cache.hh"
+
+Prefetcher::Prefetcher(QObject *parent)
+    : QObject(parent),
+      manager_(new BilibiliRequestManager(this)),
+      queue_(),
+      timer_id_(Qt::TimerId::Invalid),
+      in_flight_(),
+      from_cache_(),
+      activity_timer_()
+{
+    // 与 assetBagDataReceived 同一线程、直接连接，先于它到达
+    connect(manager_, &BilibiliRequestManager::assetBagReplyReceived, this,
+            [this](int, int, const QByteArray &data, const QByteArray &content_encoding) {
+                data_ = data;
+                content_encoding_ = content_encoding;
+                ResponseCache::compressIdentity(&data_, &content_encoding_);
+            });
+    connect(manager_, &BilibiliRequestManager::assetBagDataReceived, this,
+            [this](int act_id, const QString &act_name, int lottery_id, int,
+                   const QByteArray &json) {
+                if (!from_cache_) {
+                    bool ok;
+                    const CardStore store = CardStore::fromJson(json, &ok);
+                    if (ok) {
+                        emit prefetched(act_id, act_name, lottery_id, store, data_,
+                                        content_encoding_);
+                    }
+                }
+                finishRequest();
+            });
+    // 网络不可用时管理器会退回到缓存，缓存中的数据可能已经过期，不作为预取的结果
+    connect(manager_, &BilibiliRequestManager::cachedDataServed, this,
+            [this]() { from_cache_ = true; });
+    connect(manager_, &BilibiliRequestManager::assetBagRequestFailed, this,
+            &Prefetcher::finishRequest);
+    connect(manager_, &BilibiliRequestManager::errorOccurred, this,
+            [this](QNetworkReply *reply, QNetworkReply::NetworkError error) {
+                qWarning() << "Prefetch failed:" << error << reply->errorString();
+                // 多半是被限流或网络不可用，放弃剩下的；当前请求结束时才清除 in_flight_
+                stop();
+            });
+}
+
+void Prefetcher::setCookie(const QString &cookie)
+{
+    manager_->setCookie(cookie);
+}
+
+void Prefetcher::setCacheDirectory(const QString &dir)
+{
+    manager_->setCacheDirectory(dir);
+}
+
+void Prefetcher::prefetch(const MyDecomposeData &data)
+{
+    queue_ = data.list.value_or(QList<MyDecomposeData::ListItem>());
+    if (queue_.isEmpty() || timer_id_ != Qt::TimerId::Invalid) {
+        return;
+    }
+    timer_id_ = static_cast<Qt::TimerId>(startTimer(std::chrono::milliseconds(kIntervalMsec)));
+    if (timer_id_ == Qt::TimerId::Invalid) {
+        qWarning() << "Failed to start timer";
+    }
+}
+
+void Prefetcher::userActivity()
+{
+    activity_timer_.start();
+}
+
+void Prefetcher::stop()
+{
+    queue_.clear();
+    if (timer_id_ != Qt::TimerId::Invalid) {
+        killTimer(timer_id_);
+        timer_id_ = Qt::TimerId::Invalid;
+    }
+}
+
+void Prefetcher::finishRequest()
+{
+    in_flight_ = false;
+    from_cache_ = false;
+    data_.clear();
+    content_encoding_.clear();
+}
+
+void Prefetcher::timerEvent(QTimerEvent *event)
+{
+    if (timer_id_ == event->id()) {
+        const bool idle = !activity_timer_.isValid() || activity_timer_.hasExpired(kIdleMsec);
+        if (!in_flight_ && idle && !queue_.isEmpty()) {
+            const MyDecomposeData::ListItem item = queue_.takeFirst();
+            in_flight_ = true;
+            manager_->getAssetBag(item.act_id, item.act_name);
+        }
+        if (queue_.isEmpty()) {
+            killTimer(timer_id_);
+            timer_id_ = Qt::TimerId::Invalid;
+        }
+    }
+    QObject::timerEvent(event);
+}
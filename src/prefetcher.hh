@@ -0,0 +1,59 @@
+#ifndef PREFETCHER_HH
+#define PREFETCHER_HH
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QElapsedTimer>
+
+#include "my_decompose.hh"
+
+class CardStore;
+class BilibiliRequestManager;
+
+/// \brief 空闲时在后台预取并解析可能会打开的收藏集
+///
+/// 使用独立的 BilibiliRequestManager，结果不会打开标签页。同一时间最多一个请求，
+/// 最近一次 userActivity() 之后的 kIdleMsec 内不会发出新请求，避免与用户的操作争抢。
+/// 任何请求出错都会放弃剩下的，也不使用管理器退回到的缓存数据。
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kIdleMsec = 3000;
+    static constexpr int kIntervalMsec = 500;
+
+    explicit Prefetcher(QObject *parent = nullptr);
+
+public slots:
+    void setCookie(const QString &cookie);
+    void setCacheDirectory(const QString &dir);
+    /// 依次预取 data.list 中的收藏集，替换尚未开始的部分
+    void prefetch(const MyDecomposeData &data);
+    /// 用户发出了请求，暂停一段时间
+    void userActivity();
+    void stop();
+
+signals:
+    void prefetched(int act_id, const QString &act_name, int lottery_id, const CardStore &store,
+                    const QByteArray &data, const QByteArray &content_encoding);
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    void finishRequest();
+
+    BilibiliRequestManager *manager_;
+    QList<MyDecomposeData::ListItem> queue_;
+    Qt::TimerId timer_id_;
+    bool in_flight_;
+    bool from_cache_; ///< 当前请求的数据来自缓存
+    QElapsedTimer activity_timer_; ///< 最近一次 userActivity()
+    QByteArray data_; ///< 当前请求压缩后的响应
+    QByteArray content_encoding_;
+};
+
+#endif
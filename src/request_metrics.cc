@@ -0,0 +1,182 @@
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QtLogging>
+#include <QDebug>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <nlohmann/json.hpp>
+
+#include "request_metrics.hh"
+
+int Histogram::bucketOf(qint64 value)
+{
+    if (value < 4) {
+        return static_cast<int>(std::max<qint64>(value, 0));
+    }
+    const int exponent = 63 - static_cast<int>(qCountLeadingZeroBits(static_cast<quint64>(value)));
+    const int sub = static_cast<int>((value >> (exponent - 2)) & 3);
+    return 4 * (exponent - 1) + sub;
+}
+
+qint64 Histogram::bucketUpperBound(int bucket)
+{
+    if (bucket < 4) {
+        return bucket;
+    }
+    const int shift = bucket / 4 - 1;
+    const qint64 sub = bucket % 4;
+    // 最后一格的上界为 2^63 - 1，左移会溢出
+    if (4 + sub + 1 > (std::numeric_limits<qint64>::max() >> shift)) {
+        return std::numeric_limits<qint64>::max();
+    }
+    return ((4 + sub + 1) << shift) - 1;
+}
+
+void Histogram::add(qint64 value)
+{
+    value = std::max<qint64>(value, 0);
+    ++buckets_[bucketOf(value)];
+    min_ = count_ == 0 ? value : std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += value;
+    ++count_;
+}
+
+double Histogram::mean() const
+{
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / static_cast<double>(count_);
+}
+
+qint64 Histogram::percentile(double p) const
+{
+    if (count_ == 0) {
+        return 0;
+    }
+    const auto rank = static_cast<quint64>(std::ceil(std::clamp(p, 0.0, 1.0) * count_));
+    quint64 seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets_[i];
+        if (seen >= std::max<quint64>(rank, 1)) {
+            // 格子的上界可能超出实际的最大值
+            return std::min(bucketUpperBound(i), max_);
+        }
+    }
+    return max_;
+}
+
+RequestMetrics &RequestMetrics::instance()
+{
+    static RequestMetrics metrics;
+    return metrics;
+}
+
+void RequestMetrics::recordReply(const QString &endpoint, const ReplySample &sample)
+{
+    const QMutexLocker locker(&mutex_);
+    Endpoint &e = endpoints_[endpoint];
+    if (sample.queue_wait >= 0) {
+        e.queue_wait.add(sample.queue_wait);
+    }
+    if (sample.time_to_first_byte >= 0) {
+        e.time_to_first_byte.add(sample.time_to_first_byte);
+    }
+    e.total.add(sample.total);
+    if (sample.network_error != 0) {
+        ++e.network_errors[sample.network_error];
+    } else {
+        e.received_bytes.add(sample.received_bytes);
+    }
+}
+
+void RequestMetrics::recordDecompress(const QString &endpoint, qint64 elapsed,
+                                      qint64 decoded_bytes)
+{
+    const QMutexLocker locker(&mutex_);
+    Endpoint &e = endpoints_[endpoint];
+    e.decompress.add(elapsed);
+    e.decoded_bytes.add(decoded_bytes);
+}
+
+void RequestMetrics::recordParse(const QString &endpoint, qint64 elapsed, int code)
+{
+    const QMutexLocker locker(&mutex_);
+    Endpoint &e = endpoints_[endpoint];
+    e.parse.add(elapsed);
+    ++e.codes[code];
+}
+
+QMap<QString, RequestMetrics::Endpoint> RequestMetrics::snapshot() const
+{
+    const QMutexLocker locker(&mutex_);
+    return endpoints_;
+}
+
+void RequestMetrics::clear()
+{
+    const QMutexLocker locker(&mutex_);
+    endpoints_.clear();
+}
+
+QByteArray RequestMetrics::toJson() const
+{
+    const auto histogram = [](const Histogram &h) {
+        return nlohmann::json{
+            { "count", h.count() },
+            { "min", h.min() },
+            { "mean", h.mean() },
+            { "p50", h.percentile(0.5) },
+            { "p90", h.percentile(0.9) },
+            { "p99", h.percentile(0.99) },
+            { "max", h.max() },
+        };
+    };
+    const auto counts = [](const QMap<int, quint64> &map) {
+        nlohmann::json j = nlohmann::json::object();
+        for (auto iter = map.cbegin(); iter != map.cend(); ++iter) {
+            j[std::to_string(iter.key())] = iter.value();
+        }
+        return j;
+    };
+
+    nlohmann::json j = nlohmann::json::object();
+    const QMap<QString, Endpoint> endpoints = snapshot();
+    for (auto iter = endpoints.cbegin(); iter != endpoints.cend(); ++iter) {
+        const Endpoint &e = iter.value();
+        j[iter.key().toStdString()] = {
+            { "queue_wait_ns", histogram(e.queue_wait) },
+            { "time_to_first_byte_ns", histogram(e.time_to_first_byte) },
+            { "total_ns", histogram(e.total) },
+            { "decompress_ns", histogram(e.decompress) },
+            { "parse_ns", histogram(e.parse) },
+            { "received_bytes", histogram(e.received_bytes) },
+            { "decoded_bytes", histogram(e.decoded_bytes) },
+            { "network_errors", counts(e.network_errors) },
+            { "codes", counts(e.codes) },
+        };
+    }
+    return QByteArray::fromStdString(j.dump(2));
+}
+
+bool RequestMetrics::isEmpty() const
+{
+    const QMutexLocker locker(&mutex_);
+    return endpoints_.isEmpty();
+}
+
+bool RequestMetrics::save(const QString &file_name) const
+{
+    if (isEmpty()) {
+        return true;
+    }
+    QSaveFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Unable to open file:" << file_name;
+        return false;
+    }
+    file.write(toJson());
+    return file.commit();
+}
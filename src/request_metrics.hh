@@ -0,0 +1,89 @@
+#ifndef REQUEST_METRICS_HH
+#define REQUEST_METRICS_HH
+
+#include <QByteArray>
+#include <QString>
+#include <QMap>
+#include <QMutex>
+
+#include <array>
+
+/// \brief 对数刻度的直方图，每个 2 的幂区间再分为 4 格，相对误差不超过 25%
+class Histogram
+{
+public:
+    static constexpr int kBuckets = 248;
+
+    void add(qint64 value);
+
+    [[nodiscard]] quint64 count() const { return count_; }
+    [[nodiscard]] qint64 min() const { return count_ == 0 ? 0 : min_; }
+    [[nodiscard]] qint64 max() const { return max_; }
+    [[nodiscard]] double mean() const;
+    /// p 在 [0, 1] 之间，返回所在格子的上界
+    [[nodiscard]] qint64 percentile(double p) const;
+
+    [[nodiscard]] static int bucketOf(qint64 value);
+    [[nodiscard]] static qint64 bucketUpperBound(int bucket);
+
+private:
+    std::array<quint64, kBuckets> buckets_{};
+    quint64 count_ = 0;
+    qint64 sum_ = 0;
+    qint64 min_ = 0;
+    qint64 max_ = 0;
+};
+
+/// \brief 各个接口的请求耗时、响应大小与错误统计，时间单位均为纳秒
+///
+/// 网络线程记录请求，各个线程记录解析，所有方法都可以跨线程调用。
+class RequestMetrics
+{
+public:
+    struct Endpoint
+    {
+        Histogram queue_wait; ///< 发出请求到请求发送完毕，包括排队、连接与 TLS 握手
+        Histogram time_to_first_byte; ///< 发出请求到收到响应头
+        Histogram total;
+        Histogram decompress;
+        Histogram parse;
+        Histogram received_bytes; ///< 压缩后，即实际传输的大小
+        Histogram decoded_bytes;
+        QMap<int, quint64> network_errors; ///< {QNetworkReply::NetworkError, 次数}
+        QMap<int, quint64> codes; ///< {响应中的 code, 次数}
+    };
+
+    struct ReplySample
+    {
+        qint64 queue_wait; ///< 未知时为 -1
+        qint64 time_to_first_byte; ///< 未知时为 -1
+        qint64 total;
+        qint64 received_bytes;
+        int network_error; ///< 0 为 NoError
+    };
+
+    static RequestMetrics &instance();
+
+    void recordReply(const QString &endpoint, const ReplySample &sample);
+    void recordDecompress(const QString &endpoint, qint64 elapsed, qint64 decoded_bytes);
+    void recordParse(const QString &endpoint, qint64 elapsed, int code);
+
+    [[nodiscard]] QMap<QString, Endpoint> snapshot() const;
+    void clear();
+    [[nodiscard]] QByteArray toJson() const;
+    /// 没有任何记录时不写入
+    bool save(const QString &file_name) const;
+    [[nodiscard]] bool isEmpty() const;
+
+    static inline const QString kMyDecompose = QStringLiteral("/x/vas/smelt/my_decompose/info");
+    static inline const QString kAssetBag = QStringLiteral("/x/vas/dlc_act/asset_bag");
+    static inline const QString kImage = QStringLiteral("image");
+
+private:
+    RequestMetrics() = default;
+
+    mutable QMutex mutex_;
+    QMap<QString, Endpoint> endpoints_;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QtLogging>
+#include <QDebug>
+
+#include <nlohmann/json.hpp>
+
+#include "response_archive.hh"
+#include "compressed_file_writer.hh"
+
+using namespace Qt::Literals;
+
+namespace {
+
+/// 存档是本地文件，会随时间增长，上限比响应的 kMaxUncompressedSize 大得多，但仍然有限
+constexpr qsizetype kMaxArchiveSize = qsizetype{ 1 } << 30;
+
+} // namespace
+
+QByteArray ResponseArchiveRecord::toJsonLine() const
+{
+    // 合法的 JSON 中字符串内不会出现未转义的换行，其他位置的换行只是空白，可以直接替换
+    QByteArray compact = response;
+    compact.replace('\n', ' ').replace('\r', ' ');
+
+    QByteArray line;
+    line.reserve(std::size(compact) + 128);
+    line.append("{\"ts\":")
+            .append(QByteArray::number(timestamp.toMSecsSinceEpoch()))
+            .append(",\"act_id\":")
+            .append(QByteArray::number(act_id))
+            .append(",\"act_name\":")
+            .append(QByteArray::fromStdString(nlohmann::json(act_name.toStdString()).dump()))
+            .append(",\"lottery_id\":")
+            .append(QByteArray::number(lottery_id))
+            .append(",\"response\":")
+            .append(compact)
+            .append("}\n");
+    return line;
+}
+
+QList<ResponseArchiveRecord> readResponseArchive(const QString &file_name, bool *ok)
+{
+    if (ok) {
+        *ok = false;
+    }
+
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Unable to open file:" << file_name;
+        return {};
+    }
+
+    QByteArray data = file.readAll();
+    const auto encoding = CompressedFileWriter::encodingForFileName(file_name);
+    if (encoding == StreamCompressor::Encoding::Gzip) {
+        bool complete;
+        data = uncompressGzipPrefix(data, &complete, kMaxArchiveSize);
+        if (!complete) {
+            qWarning() << "Archive is truncated or too large, ignoring the tail:" << file_name;
+        }
+    } else if (encoding == StreamCompressor::Encoding::Brotli) {
+        bool uncompress_ok;
+        data = uncompressBrotli(data, &uncompress_ok, kMaxArchiveSize);
+        if (!uncompress_ok) {
+            qWarning() << "Failed to uncompress archive:" << file_name;
+            return {};
+        }
+    }
+
+    QList<ResponseArchiveRecord> records;
+    QHash<QPair<int, int>, qsizetype> index; // {(act_id, lottery_id), index in records}
+
+    for (auto &&line : data.split('\n')) {
+        if (line.trimmed().isEmpty()) {
+            continue;
+        }
+
+        const nlohmann::json j = nlohmann::json::parse(line.toStdString(), nullptr, false);
+        // value() 在类型不符时会抛出异常，因此先检查每个字段的类型，缺少的可选字段使用默认值
+        if (j.is_discarded() || !j.is_object() || !j.contains("response")
+            || !j.value("act_id", nlohmann::json()).is_number_integer()
+            || !j.value("ts", nlohmann::json(0)).is_number_integer()
+            || !j.value("act_name", nlohmann::json("")).is_string()
+            || !j.value("lottery_id", nlohmann::json(0)).is_number_integer()) {
+            qWarning() << "Skipping invalid archive line";
+            continue;
+        }
+
+        ResponseArchiveRecord record;
+        record.timestamp = QDateTime::fromMSecsSinceEpoch(j.value("ts", qint64()));
+        record.act_id = j.value("act_id", 0);
+        record.act_name = QString::fromStdString(j.value("act_name", std::string()));
+        record.lottery_id = j.value("lottery_id", 0);
+        record.response = QByteArray::fromStdString(j.at("response").dump());
+
+        const QPair<int, int> key(record.act_id, record.lottery_id);
+        auto iter = index.constFind(key);
+        if (iter != index.constEnd()) {
+            records[iter.value()] = std::move(record);
+        } else {
+            index.insert(key, std::size(records));
+            records.append(std::move(record));
+        }
+    }
+
+    if (ok) {
+        *ok = true;
+    }
+    return records;
+}
@@ -0,0 +1,30 @@
+#ifndef RESPONSE_ARCHIVE_HH
+#define RESPONSE_ARCHIVE_HH
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QDateTime>
+
+/// \brief 原始响应存档，每行一个 JSON 对象（JSON Lines），通常以 gzip 追加写入
+///
+/// 每行格式：
+/// {"ts":毫秒时间戳,"act_id":...,"act_name":"...","lottery_id":...,"response":{原始响应}}
+struct ResponseArchiveRecord
+{
+    QDateTime timestamp;
+    int act_id;
+    QString act_name;
+    int lottery_id;
+    QByteArray response;
+
+    [[nodiscard]] QByteArray toJsonLine() const;
+};
+
+/// \brief 读取整个存档，对同一 (act_id, lottery_id) 只保留最新的记录，顺序为首次出现的顺序
+///
+/// 最后一行不完整（例如写入时程序被中止）时会被忽略。gzip 存档的最后一个成员不完整或损坏时，
+/// 保留之前解压出的内容。Brotli 流不能首尾相接，.br 存档只能一次写入，不能追加。
+QList<ResponseArchiveRecord> readResponseArchive(const QString &file_name, bool *ok = nullptr);
+
+#endif
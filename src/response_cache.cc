@@ -0,0 +1,81 @@
+#include <QtLogging>
+#include <QDebug>
+
+#include "response_cache.hh"
+#include "compress_helper.hh"
+#include "trace.hh"
+
+void ResponseCache::compressIdentity(QByteArray *data, QByteArray *content_encoding)
+{
+    TRACE_SCOPE("network", "ResponseCache::compressIdentity");
+    if (!content_encoding->isEmpty()) {
+        return;
+    }
+    bool ok;
+    const QByteArray compressed = compressBrotli(*data, &ok);
+    if (ok) {
+        *data = compressed;
+        *content_encoding = "br";
+    } else {
+        qWarning() << "Unable to compress response";
+    }
+}
+
+void ResponseCache::insert(int act_id, int lottery_id, const QByteArray &data,
+                           const QByteArray &content_encoding)
+{
+    const Entry entry{ data, content_encoding };
+    remove(act_id, lottery_id);
+    bytes_ += std::size(entry.data);
+    entries_.insert(qMakePair(act_id, lottery_id), entry);
+}
+
+void ResponseCache::remove(int act_id, int lottery_id)
+{
+    auto iter = entries_.find(qMakePair(act_id, lottery_id));
+    if (iter != entries_.end()) {
+        bytes_ -= std::size(iter->data);
+        entries_.erase(iter);
+    }
+}
+
+void ResponseCache::clear()
+{
+    entries_.clear();
+    bytes_ = 0;
+}
+
+bool ResponseCache::contains(int act_id, int lottery_id) const
+{
+    return entries_.contains(qMakePair(act_id, lottery_id));
+}
+
+bool ResponseCache::compressedData(int act_id, int lottery_id, QByteArray *data,
+                                   QByteArray *content_encoding) const
+{
+    auto iter = entries_.constFind(qMakePair(act_id, lottery_id));
+    if (iter == entries_.constEnd()) {
+        return false;
+    }
+    *data = iter->data;
+    *content_encoding = iter->content_encoding;
+    return true;
+}
+
+QByteArray ResponseCache::json(int act_id, int lottery_id, bool *ok) const
+{
+    auto iter = entries_.constFind(qMakePair(act_id, lottery_id));
+    if (iter == entries_.constEnd()) {
+        if (ok) {
+            *ok = false;
+        }
+        return {};
+    }
+    if (iter->content_encoding.isEmpty()) {
+        if (ok) {
+            *ok = true;
+        }
+        return iter->data;
+    }
+    return uncompress(iter->data, iter->content_encoding, ok);
+}
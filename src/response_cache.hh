@@ -0,0 +1,45 @@
+#ifndef RESPONSE_CACHE_HH
+#define RESPONSE_CACHE_HH
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+
+/// \brief 以压缩形式保存的 asset_bag 响应
+///
+/// 直接保存服务器返回的 gzip/Brotli 数据，只在需要重新构建视图时解压，
+/// 占用的内存约为传输大小。只保存已打开的标签页的响应，总量由 TabMemoryManager 限制。
+class ResponseCache
+{
+public:
+    /// 未压缩的响应用 Brotli 压缩，失败时保持原样；不访问成员，应在网络线程中调用以免阻塞界面
+    static void compressIdentity(QByteArray *data, QByteArray *content_encoding);
+
+    /// data 原样保存，未压缩的先用 compressIdentity() 压缩
+    void insert(int act_id, int lottery_id, const QByteArray &data,
+                const QByteArray &content_encoding);
+    void remove(int act_id, int lottery_id);
+    void clear();
+    [[nodiscard]] bool contains(int act_id, int lottery_id) const;
+    /// 未解压的数据，不存在时返回 false
+    bool compressedData(int act_id, int lottery_id, QByteArray *data,
+                        QByteArray *content_encoding) const;
+    /// 解压后的 JSON，不存在或解压失败时 ok 为 false
+    [[nodiscard]] QByteArray json(int act_id, int lottery_id, bool *ok = nullptr) const;
+
+    [[nodiscard]] qsizetype size() const { return std::size(entries_); }
+    /// 压缩数据的总字节数
+    [[nodiscard]] qsizetype memoryUsage() const { return bytes_; }
+
+private:
+    struct Entry
+    {
+        QByteArray data;
+        QByteArray content_encoding;
+    };
+
+    QHash<QPair<int, int>, Entry> entries_;
+    qsizetype bytes_ = 0;
+};
+
+#endif
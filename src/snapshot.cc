@@ -0,0 +1,150 @@
+#include <QSaveFile>
+#include <QtEndian>
+#include <QtLogging>
+#include <QDebug>
+
+#include <cstddef>
+
+#include "snapshot.hh"
+#include "compress_helper.hh"
+
+namespace {
+
+struct FileHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 count;
+};
+
+struct EntryHeader
+{
+    quint8 kind;
+    quint8 flags;
+    quint8 reserved[2];
+    qint32 id;
+    qint32 lottery_id;
+    quint32 act_name_size;
+    quint32 content_encoding_size;
+    quint32 data_size;
+};
+
+static_assert(sizeof(FileHeader) == 12);
+static_assert(sizeof(EntryHeader) == 24);
+
+constexpr quint8 kCurrentFlag = 0x1;
+
+} // namespace
+
+QByteArray SnapshotEntry::json(bool *ok) const
+{
+    if (content_encoding.isEmpty()) {
+        if (ok) {
+            *ok = true;
+        }
+        // data 引用映射的内存，复制一份，调用者可以在 Snapshot 析构后继续持有
+        return QByteArray(data.constData(), std::size(data));
+    }
+    return uncompress(data, content_encoding, ok);
+}
+
+bool Snapshot::open(const QString &file_name)
+{
+    entries_.clear();
+    if (file_.isOpen()) {
+        file_.close();
+    }
+
+    file_.setFileName(file_name);
+    if (!file_.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const qint64 size = file_.size();
+    const uchar *map = file_.map(0, size);
+    if (map == nullptr || size < static_cast<qint64>(sizeof(FileHeader))) {
+        file_.close();
+        return false;
+    }
+
+    const quint32 magic = qFromLittleEndian<quint32>(map + offsetof(FileHeader, magic));
+    const quint32 version = qFromLittleEndian<quint32>(map + offsetof(FileHeader, version));
+    const quint32 count = qFromLittleEndian<quint32>(map + offsetof(FileHeader, count));
+    if (magic != kMagic || version != kVersion) {
+        qWarning() << "Ignoring snapshot with unsupported version:" << version;
+        file_.close();
+        return false;
+    }
+
+    qint64 offset = sizeof(FileHeader);
+    QList<SnapshotEntry> entries;
+    for (quint32 i = 0; i < count; ++i) {
+        if (size - offset < static_cast<qint64>(sizeof(EntryHeader))) {
+            break;
+        }
+        const uchar *p = map + offset;
+        SnapshotEntry entry;
+        entry.kind = static_cast<SnapshotEntry::Kind>(p[offsetof(EntryHeader, kind)]);
+        entry.current = (p[offsetof(EntryHeader, flags)] & kCurrentFlag) != 0;
+        entry.id = qFromLittleEndian<qint32>(p + offsetof(EntryHeader, id));
+        entry.lottery_id = qFromLittleEndian<qint32>(p + offsetof(EntryHeader, lottery_id));
+        const qint64 act_name_size =
+                qFromLittleEndian<quint32>(p + offsetof(EntryHeader, act_name_size));
+        const qint64 content_encoding_size =
+                qFromLittleEndian<quint32>(p + offsetof(EntryHeader, content_encoding_size));
+        const qint64 data_size = qFromLittleEndian<quint32>(p + offsetof(EntryHeader, data_size));
+        offset += sizeof(EntryHeader);
+        if (size - offset < act_name_size + content_encoding_size + data_size) {
+            break;
+        }
+
+        const char *q = reinterpret_cast<const char *>(map + offset);
+        entry.act_name = QString::fromUtf8(q, act_name_size);
+        entry.content_encoding = QByteArray(q + act_name_size, content_encoding_size);
+        // 不复制，直接引用映射的内存
+        entry.data = QByteArray::fromRawData(q + act_name_size + content_encoding_size, data_size);
+        offset += act_name_size + content_encoding_size + data_size;
+        entries.append(std::move(entry));
+    }
+
+    if (static_cast<quint32>(std::size(entries)) != count) {
+        qWarning() << "Truncated snapshot:" << file_name;
+    }
+    entries_ = std::move(entries);
+    return true;
+}
+
+bool Snapshot::write(const QString &file_name, const QList<SnapshotEntry> &entries)
+{
+    QSaveFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    uchar file_header[sizeof(FileHeader)];
+    qToLittleEndian<quint32>(kMagic, file_header + offsetof(FileHeader, magic));
+    qToLittleEndian<quint32>(kVersion, file_header + offsetof(FileHeader, version));
+    qToLittleEndian<quint32>(static_cast<quint32>(std::size(entries)),
+                             file_header + offsetof(FileHeader, count));
+    file.write(reinterpret_cast<const char *>(file_header), sizeof(file_header));
+
+    for (auto &&entry : entries) {
+        const QByteArray act_name = entry.act_name.toUtf8();
+        uchar entry_header[sizeof(EntryHeader)] = {};
+        entry_header[offsetof(EntryHeader, kind)] = entry.kind;
+        entry_header[offsetof(EntryHeader, flags)] = entry.current ? kCurrentFlag : 0;
+        qToLittleEndian<qint32>(entry.id, entry_header + offsetof(EntryHeader, id));
+        qToLittleEndian<qint32>(entry.lottery_id, entry_header + offsetof(EntryHeader, lottery_id));
+        qToLittleEndian<quint32>(static_cast<quint32>(std::size(act_name)),
+                                 entry_header + offsetof(EntryHeader, act_name_size));
+        qToLittleEndian<quint32>(static_cast<quint32>(std::size(entry.content_encoding)),
+                                 entry_header + offsetof(EntryHeader, content_encoding_size));
+        qToLittleEndian<quint32>(static_cast<quint32>(std::size(entry.data)),
+                                 entry_header + offsetof(EntryHeader, data_size));
+        file.write(reinterpret_cast<const char *>(entry_header), sizeof(entry_header));
+        file.write(act_name);
+        file.write(entry.content_encoding);
+        file.write(entry.data);
+    }
+
+    return file.commit();
+}
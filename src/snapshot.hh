@@ -0,0 +1,54 @@
+#ifndef SNAPSHOT_HH
+#define SNAPSHOT_HH
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QFile>
+
+/// \brief 快照中的一条压缩响应
+struct SnapshotEntry
+{
+    enum Kind : quint8 {
+        MyDecompose = 1, ///< id 为 scene
+        AssetBag = 2, ///< id 为 act_id
+    };
+
+    Kind kind;
+    bool current; ///< 退出时是否为当前标签页
+    int id;
+    int lottery_id;
+    QString act_name;
+    QByteArray content_encoding; ///< 为空表示未压缩
+    QByteArray data;
+
+    /// 解压后的 JSON，总是持有自己的数据
+    [[nodiscard]] QByteArray json(bool *ok = nullptr) const;
+};
+
+/// \brief 退出时保存、启动时立即显示的数据快照
+///
+/// 小端序二进制格式：文件头为魔数、版本号与条目数，之后每个条目是固定长度的头部加上
+/// 收藏集名、Content-Encoding 与压缩数据。读取时映射整个文件，各条目的 data 直接引用映射的内存，
+/// 只有在解压时才会读到。版本号不匹配时视为没有快照。
+class Snapshot
+{
+public:
+    static constexpr quint32 kMagic = 0x53424342; // "BCBS"
+    static constexpr quint32 kVersion = 1;
+
+    Snapshot() = default;
+    Q_DISABLE_COPY_MOVE(Snapshot)
+
+    /// 返回的条目在 Snapshot 析构或再次 open() 之前有效
+    bool open(const QString &file_name);
+    [[nodiscard]] const QList<SnapshotEntry> &entries() const { return entries_; }
+
+    static bool write(const QString &file_name, const QList<SnapshotEntry> &entries);
+
+private:
+    QFile file_;
+    QList<SnapshotEntry> entries_;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include <QCoreApplication>
+#include <QThread>
+#include <QMetaEnum>
+#include <QMutexLocker>
+#include <QtLogging>
+#include <QDebug>
+
+#include "stall_detector.hh"
+#include "trace.hh"
+
+using namespace Qt::Literals;
+
+double StallDetector::Statistics::stallsPerMinute() const
+{
+    if (elapsed <= 0) {
+        return 0;
+    }
+    return static_cast<double>(stalls.count()) * 60e9 / static_cast<double>(elapsed);
+}
+
+StallDetector::StallDetector(QObject *parent)
+    : QObject(parent),
+      thread_(),
+      threshold_(kDefaultThresholdMsec),
+      gui_span_(Trace::activeSpan()),
+      last_receiver_(nullptr),
+      last_event_type_(QEvent::None),
+      stopping_(false),
+      acknowledged_(-1),
+      elapsed_(0)
+{
+    Q_ASSERT(QThread::currentThread() == qApp->thread());
+}
+
+StallDetector::~StallDetector()
+{
+    stop();
+}
+
+void StallDetector::setThreshold(int msec)
+{
+    threshold_.store(qMax(msec, kIntervalMsec), std::memory_order_relaxed);
+}
+
+StallDetector::Statistics StallDetector::statistics() const
+{
+    const QMutexLocker locker(&mutex_);
+    return Statistics{ latency_, stalls_, culprits_,
+                       elapsed_ + (running_.isValid() ? running_.nsecsElapsed() : 0) };
+}
+
+void StallDetector::start()
+{
+    if (thread_ != nullptr) {
+        return;
+    }
+    {
+        const QMutexLocker locker(&mutex_);
+        stopping_ = false;
+        acknowledged_ = -1;
+        running_.start();
+    }
+    qApp->installEventFilter(this);
+    thread_ = QThread::create(&StallDetector::run, this);
+    thread_->setObjectName(u"watchdog"_s);
+    thread_->start(QThread::HighPriority);
+}
+
+void StallDetector::stop()
+{
+    if (thread_ == nullptr) {
+        return;
+    }
+    {
+        const QMutexLocker locker(&mutex_);
+        stopping_ = true;
+        condition_.wakeAll();
+    }
+    thread_->wait();
+    delete thread_;
+    thread_ = nullptr;
+    qApp->removeEventFilter(this);
+
+    const QMutexLocker locker(&mutex_);
+    elapsed_ += running_.nsecsElapsed();
+    running_.invalidate();
+}
+
+bool StallDetector::eventFilter(QObject *watched, QEvent *event)
+{
+    // 只记录指针与整数，类名在卡顿时才转换为字符串
+    last_receiver_.store(watched->metaObject()->className(), std::memory_order_relaxed);
+    last_event_type_.store(event->type(), std::memory_order_relaxed);
+    return QObject::eventFilter(watched, event);
+}
+
+QString StallDetector::currentCulprit() const
+{
+    if (const char *span = gui_span_->load(std::memory_order_relaxed)) {
+        return QString::fromUtf8(span);
+    }
+    const char *receiver = last_receiver_.load(std::memory_order_relaxed);
+    if (receiver == nullptr) {
+        return u"未知"_s;
+    }
+    const int type = last_event_type_.load(std::memory_order_relaxed);
+    const char *type_name = QMetaEnum::fromType<QEvent::Type>().valueToKey(type);
+    return QString::fromUtf8(receiver) % "::"
+            % (type_name != nullptr ? QString::fromUtf8(type_name) : QString::number(type));
+}
+
+bool StallDetector::waitForAcknowledgement(qint64 sent, QDeadlineTimer deadline)
+{
+    while (acknowledged_ != sent && !stopping_) {
+        if (!condition_.wait(&mutex_, deadline)) {
+            return acknowledged_ == sent;
+        }
+    }
+    return true;
+}
+
+void StallDetector::run()
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    QMutexLocker locker(&mutex_);
+    while (!stopping_) {
+        const qint64 sent = clock.nsecsElapsed();
+        const qint64 trace_sent = Trace::isEnabled() ? Trace::now() : -1;
+        QMetaObject::invokeMethod(
+                this,
+                [this, sent]() {
+                    const QMutexLocker locker(&mutex_);
+                    acknowledged_ = sent;
+                    condition_.wakeAll();
+                },
+                Qt::QueuedConnection);
+
+        // 超过阈值仍未执行时记下 GUI 线程此刻正在做什么，然后继续等待以得到卡顿时长
+        QString culprit;
+        if (!waitForAcknowledgement(sent, QDeadlineTimer(threshold()))) {
+            culprit = currentCulprit();
+            waitForAcknowledgement(sent, QDeadlineTimer(QDeadlineTimer::Forever));
+        }
+        if (stopping_) {
+            break;
+        }
+
+        const qint64 latency = clock.nsecsElapsed() - sent;
+        latency_.add(latency);
+        if (!culprit.isEmpty()) {
+            stalls_.add(latency);
+            ++culprits_[culprit];
+            locker.unlock();
+            qWarning().noquote() << u"GUI 线程卡顿 %1 ms：%2"_s.arg(latency / 1000000).arg(culprit);
+            if (trace_sent >= 0 && Trace::isEnabled()) {
+                Trace::record(Trace::Phase::Complete, "watchdog", "GUI stall", trace_sent, latency);
+            }
+            emit stallDetected(latency, culprit);
+            locker.relock();
+        }
+
+        // 可以被 stop() 提前唤醒
+        condition_.wait(&mutex_, QDeadlineTimer(kIntervalMsec));
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef STALL_DETECTOR_HH
+#define STALL_DETECTOR_HH
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QDeadlineTimer>
+#include <QEvent>
+
+#include <atomic>
+
+#include "request_metrics.hh"
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+/// \brief 在辅助线程中测量 GUI 事件循环的延迟，记录超过阈值的卡顿
+///
+/// 辅助线程每隔 kIntervalMsec 向 GUI 线程投递一个空调用，等待它被执行。超过阈值仍未执行时，
+/// 读取 GUI 线程此刻最内层的 Trace::Span，没有 Span 时使用最近分发的事件的接收者与类型，
+/// 在调用执行后与卡顿时长一起输出警告。必须在 GUI 线程中构造与调用。
+class StallDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kIntervalMsec = 50;
+    static constexpr int kDefaultThresholdMsec = 200;
+
+    struct Statistics
+    {
+        Histogram latency; ///< 每次探测的事件循环延迟，纳秒
+        Histogram stalls; ///< 超过阈值的卡顿时长，纳秒
+        QHash<QString, quint64> culprits; ///< {卡顿时正在执行的 Span 或事件, 次数}
+        qint64 elapsed; ///< 监视的总时长，纳秒
+
+        [[nodiscard]] double stallsPerMinute() const;
+    };
+
+    explicit StallDetector(QObject *parent = nullptr);
+    ~StallDetector() override;
+
+    void setThreshold(int msec);
+    [[nodiscard]] int threshold() const { return threshold_.load(std::memory_order_relaxed); }
+    [[nodiscard]] bool isRunning() const { return thread_ != nullptr; }
+    [[nodiscard]] Statistics statistics() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    /// 在辅助线程中发出，duration 为纳秒
+    void stallDetected(qint64 duration, const QString &culprit);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void run();
+    /// 等待 GUI 线程执行 sent 对应的调用，调用时持有 mutex_
+    bool waitForAcknowledgement(qint64 sent, QDeadlineTimer deadline);
+    [[nodiscard]] QString currentCulprit() const;
+
+    QThread *thread_;
+    std::atomic_int threshold_;
+    const std::atomic<const char *> *gui_span_;
+    std::atomic<const char *> last_receiver_; ///< 类名
+    std::atomic_int last_event_type_;
+
+    mutable QMutex mutex_;
+    QWaitCondition condition_;
+    bool stopping_;
+    qint64 acknowledged_;
+    Histogram latency_;
+    Histogram stalls_;
+    QHash<QString, quint64> culprits_;
+    qint64 elapsed_; ///< 之前几次运行的总时长
+    QElapsedTimer running_;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include <QTabWidget>
+
+#include "tab_memory_manager.hh"
+#include "asset_bag.hh"
+#include "card_store.hh"
+#include "response_cache.hh"
+#include "trace.hh"
+
+TabMemoryManager::TabMemoryManager(QTabWidget *tab_widget, ResponseCache *cache, QObject *parent)
+    : QObject(parent),
+      tab_widget_(tab_widget),
+      cache_(cache),
+      budget_(256LL * 1024 * 1024),
+      prefetched_usage_(),
+      lru_()
+{
+    connect(tab_widget_, &QTabWidget::currentChanged, this, &TabMemoryManager::onCurrentChanged);
+}
+
+void TabMemoryManager::setBudget(qsizetype bytes)
+{
+    budget_ = bytes;
+    trim();
+}
+
+qsizetype TabMemoryManager::memoryUsage() const
+{
+    qsizetype bytes = prefetched_usage_;
+    for (const AssetBag *asset_bag : lru_) {
+        bytes += asset_bag->memoryUsage();
+    }
+    return bytes;
+}
+
+void TabMemoryManager::setPrefetchedUsage(qsizetype bytes)
+{
+    const bool grew = bytes > prefetched_usage_;
+    prefetched_usage_ = bytes;
+    if (grew) {
+        trim();
+    }
+}
+
+void TabMemoryManager::touch(AssetBag *asset_bag)
+{
+    lru_.removeOne(asset_bag);
+    lru_.prepend(asset_bag);
+    trim();
+}
+
+void TabMemoryManager::remove(AssetBag *asset_bag)
+{
+    lru_.removeOne(asset_bag);
+}
+
+void TabMemoryManager::onCurrentChanged(int index)
+{
+    AssetBag *asset_bag = qobject_cast<AssetBag *>(tab_widget_->widget(index));
+    if (asset_bag != nullptr) {
+        activate(asset_bag);
+    }
+}
+
+void TabMemoryManager::activate(AssetBag *asset_bag)
+{
+    TRACE_SCOPE("gui", "TabMemoryManager::activate");
+    const int act_id = asset_bag->actId();
+    const int lottery_id = asset_bag->lotteryId();
+    if (!asset_bag->hasCardStore() && cache_->contains(act_id, lottery_id)) {
+        bool ok;
+        const QByteArray json = cache_->json(act_id, lottery_id, &ok);
+        const CardStore store = ok ? CardStore::fromJson(json, &ok) : CardStore();
+        if (ok) {
+            asset_bag->setCardStore(store);
+        }
+    }
+    asset_bag->reload();
+    touch(asset_bag);
+}
+
+void TabMemoryManager::trim()
+{
+    // 预取的数据只是推测，先于标签页丢弃
+    if (prefetched_usage_ > 0 && memoryUsage() > budget_) {
+        emit prefetchedReleaseRequested();
+    }
+    qsizetype bytes = memoryUsage();
+    const QWidget *current = tab_widget_->currentWidget();
+    // 先卸载树，仍然超出再释放可以从压缩响应重建的 CardStore
+    for (const bool release_store : { false, true }) {
+        for (auto iter = lru_.crbegin(); iter != lru_.crend() && bytes > budget_; ++iter) {
+            AssetBag *asset_bag = *iter;
+            if (asset_bag == current) {
+                continue;
+            }
+            const qsizetype before = asset_bag->memoryUsage();
+            if (!release_store) {
+                asset_bag->unload();
+            } else if (asset_bag->hasCardStore()
+                       && cache_->contains(asset_bag->actId(), asset_bag->lotteryId())) {
+                asset_bag->unload();
+                asset_bag->releaseCardStore();
+            }
+            bytes -= before - asset_bag->memoryUsage();
+        }
+    }
+    trimCache();
+}
+
+void TabMemoryManager::trimCache()
+{
+    const QWidget *current = tab_widget_->currentWidget();
+    for (auto iter = lru_.crbegin();
+         iter != lru_.crend() && cache_->memoryUsage() > kCacheCapacity; ++iter) {
+        AssetBag *asset_bag = *iter;
+        // CardStore 已释放的只能从响应重建
+        if (asset_bag != current && asset_bag->hasCardStore()) {
+            cache_->remove(asset_bag->actId(), asset_bag->lotteryId());
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef TAB_MEMORY_MANAGER_HH
+#define TAB_MEMORY_MANAGER_HH
+
+#include <QObject>
+#include <QList>
+
+QT_BEGIN_NAMESPACE
+class QTabWidget;
+QT_END_NAMESPACE
+
+class AssetBag;
+class ResponseCache;
+
+/// \brief 限制所有 AssetBag 标签页的内存
+///
+/// 按最近一次显示的顺序记录标签页，总量超出预算时从最久没有看过的隐藏标签页开始卸载，
+/// 只保留其 CardStore；仍然超出时若 ResponseCache 中有该收藏集的压缩响应，CardStore 也释放，
+/// 再次切换到该标签页时从压缩响应重新解析。当前标签页不会被卸载。
+///
+/// 预取但尚未打开的收藏集也计入预算，超出时先于标签页丢弃。
+///
+/// ResponseCache 不计入预算，单独限制为 kCacheCapacity，超出时同样从最久没有看过的标签页开始
+/// 丢弃压缩响应，但不会丢弃已经释放了 CardStore、只能从响应重建的。
+class TabMemoryManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr qsizetype kCacheCapacity = 64LL * 1024 * 1024;
+
+    TabMemoryManager(QTabWidget *tab_widget, ResponseCache *cache, QObject *parent = nullptr);
+
+    [[nodiscard]] qsizetype budget() const { return budget_; }
+    void setBudget(qsizetype bytes);
+    /// 包括预取的数据，不包括 ResponseCache 中的压缩响应
+    [[nodiscard]] qsizetype memoryUsage() const;
+    /// 预取但尚未打开的收藏集占用的内存
+    void setPrefetchedUsage(qsizetype bytes);
+
+signals:
+    /// 超出预算时请求丢弃全部预取的数据，接收者丢弃后应当调用 setPrefetchedUsage(0)
+    void prefetchedReleaseRequested();
+
+public slots:
+    /// 标签页的数据有变化或被显示时调用
+    void touch(AssetBag *asset_bag);
+    void remove(AssetBag *asset_bag);
+    /// 确保标签页已填充，必要时从压缩响应重新解析；切换标签页时自动调用
+    void activate(AssetBag *asset_bag);
+
+private slots:
+    void onCurrentChanged(int index);
+
+private:
+    void trim();
+    void trimCache();
+
+    QTabWidget *tab_widget_;
+    ResponseCache *cache_;
+    qsizetype budget_;
+    qsizetype prefetched_usage_;
+    QList<AssetBag *> lru_; ///< 第一个为最近显示的
+};
+
+#endif
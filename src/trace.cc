@@ -0,0 +1,173 @@
+#include <QSaveFile>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtLogging>
+#include <QDebug>
+
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "trace.hh"
+
+using namespace Qt::Literals;
+
+namespace Trace {
+
+namespace detail {
+std::atomic_bool enabled = false;
+}
+
+namespace {
+
+struct Event
+{
+    const char *category;
+    const char *name;
+    qint64 timestamp;
+    qint64 duration;
+    quint64 id;
+    Phase phase;
+};
+
+struct ThreadBuffer
+{
+    int tid;
+    QString thread_name;
+    QMutex mutex; ///< 只有 stop() 会与所属线程竞争
+    std::vector<Event> events;
+};
+
+std::atomic<qint64> epoch = 0;
+QMutex buffers_mutex;
+// 线程结束后缓冲区仍然保留，直到下一次 start()
+std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+thread_local std::shared_ptr<ThreadBuffer> local_buffer;
+
+qint64 steadyNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+ThreadBuffer &localBuffer()
+{
+    if (!local_buffer) {
+        local_buffer = std::make_shared<ThreadBuffer>();
+        const QString name = QThread::currentThread()->objectName();
+        const QMutexLocker locker(&buffers_mutex);
+        buffers.push_back(local_buffer);
+        local_buffer->tid = static_cast<int>(std::size(buffers));
+        local_buffer->thread_name =
+                name.isEmpty() ? u"thread %1"_s.arg(local_buffer->tid) : name;
+        local_buffer->events.reserve(4096);
+    }
+    return *local_buffer;
+}
+
+QByteArray microseconds(qint64 nsecs)
+{
+    return QByteArray::number(static_cast<double>(nsecs) / 1000.0, 'f', 3);
+}
+
+} // namespace
+
+void start()
+{
+    {
+        const QMutexLocker locker(&buffers_mutex);
+        for (auto &&buffer : buffers) {
+            const QMutexLocker buffer_locker(&buffer->mutex);
+            buffer->events.clear();
+        }
+    }
+    epoch.store(steadyNow(), std::memory_order_relaxed);
+    detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+qint64 now()
+{
+    return steadyNow() - epoch.load(std::memory_order_relaxed);
+}
+
+void record(Phase phase, const char *category, const char *name, qint64 timestamp,
+            qint64 duration, quint64 id)
+{
+    ThreadBuffer &buffer = localBuffer();
+    const QMutexLocker locker(&buffer.mutex);
+    buffer.events.push_back(Event{ category, name, timestamp, duration, id, phase });
+}
+
+bool stop(const QString &file_name)
+{
+    detail::enabled.store(false, std::memory_order_relaxed);
+
+    QSaveFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Unable to open file:" << file_name;
+        return false;
+    }
+
+    QByteArray out;
+    out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    const auto separator = [&out, &first]() {
+        if (!std::exchange(first, false)) {
+            out.append(",\n");
+        }
+    };
+
+    const QMutexLocker locker(&buffers_mutex);
+    for (auto &&buffer : buffers) {
+        const QMutexLocker buffer_locker(&buffer->mutex);
+        const QByteArray tid = QByteArray::number(buffer->tid);
+        separator();
+        out.append("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":")
+                .append(tid)
+                .append(",\"args\":{\"name\":")
+                .append(QByteArray::fromStdString(
+                        nlohmann::json(buffer->thread_name.toStdString()).dump()))
+                .append("}}");
+
+        for (auto &&event : buffer->events) {
+            separator();
+            out.append("{\"ph\":\"")
+                    .append(static_cast<char>(event.phase))
+                    .append("\",\"cat\":\"")
+                    .append(event.category)
+                    .append("\",\"name\":\"")
+                    .append(event.name)
+                    .append("\",\"pid\":1,\"tid\":")
+                    .append(tid)
+                    .append(",\"ts\":")
+                    .append(microseconds(event.timestamp));
+            switch (event.phase) {
+            case Phase::Complete:
+                out.append(",\"dur\":").append(microseconds(event.duration));
+                break;
+            case Phase::FlowEnd:
+                // 绑定到包含该时刻的 Span，而不是下一个开始的 Span
+                out.append(",\"bp\":\"e\"");
+                Q_FALLTHROUGH();
+            default:
+                out.append(",\"id\":\"0x").append(QByteArray::number(event.id, 16)).append('"');
+                break;
+            }
+            out.append('}');
+        }
+
+        file.write(out);
+        out.clear();
+    }
+    out.append("\n]}\n");
+    file.write(out);
+
+    return file.commit();
+}
+
+} // namespace Trace
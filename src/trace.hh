@@ -0,0 +1,115 @@
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include <QString>
+#include <QtTypes>
+
+#include <atomic>
+
+/// \brief 轻量的跨线程耗时追踪，输出 Chrome trace event 格式的 JSON（可以直接用 Perfetto 打开）
+///
+/// 没有定义 ENABLE_TRACING 时所有 TRACE_* 宏都为空；定义了但没有 Trace::start() 时每处只有一次原子读取。
+/// 每个线程写自己的缓冲区，Trace::stop() 时合并写入文件。事件名与分类只保存指针，必须是字符串字面量。
+namespace Trace {
+
+enum class Phase : char {
+    Complete = 'X',
+    AsyncBegin = 'b',
+    AsyncEnd = 'e',
+    FlowStart = 's',
+    FlowEnd = 'f',
+};
+
+namespace detail {
+extern std::atomic_bool enabled;
+/// 当前线程最内层 Span 的名字，没有 Trace::start() 时也会更新
+inline thread_local std::atomic<const char *> active_span{ nullptr };
+} // namespace detail
+
+[[nodiscard]] inline bool isEnabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+/// 开始记录，丢弃之前的事件
+void start();
+/// 停止记录并写入文件
+bool stop(const QString &file_name);
+
+/// 调用线程最内层 Span 的名字，返回的指针在线程结束前有效，可以在其他线程中读取
+[[nodiscard]] inline const std::atomic<const char *> *activeSpan()
+{
+    return &detail::active_span;
+}
+
+/// 从 start() 开始的纳秒数
+[[nodiscard]] qint64 now();
+void record(Phase phase, const char *category, const char *name, qint64 timestamp,
+            qint64 duration = 0, quint64 id = 0);
+
+/// 跨线程的 flow 事件以 {act_id, lottery_id} 或 {-1, scene} 关联信号的发出与接收
+[[nodiscard]] constexpr quint64 flowId(int a, int b)
+{
+    return (static_cast<quint64>(static_cast<quint32>(a)) << 32) | static_cast<quint32>(b);
+}
+
+class Span
+{
+public:
+    Span(const char *category, const char *name)
+        : category_(category),
+          name_(name),
+          parent_(detail::active_span.load(std::memory_order_relaxed)),
+          begin_(isEnabled() ? now() : -1)
+    {
+        // 只有本线程会写，不需要 exchange
+        detail::active_span.store(name, std::memory_order_relaxed);
+    }
+    ~Span()
+    {
+        if (begin_ >= 0) {
+            record(Phase::Complete, category_, name_, begin_, now() - begin_);
+        }
+        detail::active_span.store(parent_, std::memory_order_relaxed);
+    }
+    Q_DISABLE_COPY_MOVE(Span)
+
+private:
+    const char *category_;
+    const char *name_;
+    const char *parent_;
+    qint64 begin_;
+};
+
+} // namespace Trace
+
+#ifdef ENABLE_TRACING
+#  define TRACE_CONCAT_IMPL(a, b) a##b
+#  define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#  define TRACE_SCOPE(category, name) \
+      const Trace::Span TRACE_CONCAT(trace_span_, __LINE__)(category, name)
+#  define TRACE_EVENT(phase, category, name, id)                                            \
+      do {                                                                                  \
+          if (Trace::isEnabled()) {                                                         \
+              Trace::record(Trace::Phase::phase, category, name, Trace::now(), 0, (id)); \
+          }                                                                                 \
+      } while (false)
+#else
+#  define TRACE_SCOPE(category, name) \
+      do {                            \
+      } while (false)
+// sizeof 不会求值，只是避免 id 只在这里用到的变量产生未使用的警告
+#  define TRACE_EVENT(phase, category, name, id) \
+      do {                                       \
+          static_cast<void>(sizeof(id));         \
+      } while (false)
+#endif
+
+/// 异步事件，例如网络请求，可以在不同的调用栈中开始与结束
+#define TRACE_ASYNC_BEGIN(category, name, id) TRACE_EVENT(AsyncBegin, category, name, id)
+#define TRACE_ASYNC_END(category, name, id) TRACE_EVENT(AsyncEnd, category, name, id)
+/// 连接两个线程中的 Span，例如排队信号的发出与对应槽函数的执行
+#define TRACE_FLOW_START(category, name, id) TRACE_EVENT(FlowStart, category, name, id)
+#define TRACE_FLOW_END(category, name, id) TRACE_EVENT(FlowEnd, category, name, id)
+
+#endif